@@ -0,0 +1,964 @@
+#include "scenes.h"
+
+#include "chrono"
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "memory"
+#include "random"
+#include "string"
+#include "vector"
+
+using namespace gabbyphysics;
+using namespace bench;
+
+struct Options
+{
+    unsigned steps = 500;
+    unsigned size = 512;
+    real duration = 1.0f / 60.0f;
+    bool use_store = false;
+    unsigned threads = 1;
+    ParticleContactResolver::Mode resolver = ParticleContactResolver::ITERATIVE;
+    bool sequential_impulse = false;
+    bool sweep_and_prune = false;
+    ParticleForceRegistry::Mode registry = ParticleForceRegistry::VIRTUAL;
+    unsigned reorder = 0;
+    std::vector<std::string> scenes;
+};
+
+static void usage()
+{
+    std::printf("usage: gabbyphysics-bench [--steps n] [--size n] [--dt seconds] [--store] [--threads n] [--resolver iterative|priority|pgs] [--broadphase hash|sap] [--registry virtual|batched] [--reorder frames] [bridge] [rope] [rain] [pile] [pegs] [cloth] [fluid] [integrate] [collide] [forces] [fields] [contacts] [random] [sph]\n");
+}
+
+static bool parse_options(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(arg, "--steps") == 0 && has_value)
+            options.steps = std::strtoul(argv[++i], 0, 10);
+        else if (std::strcmp(arg, "--size") == 0 && has_value)
+            options.size = std::strtoul(argv[++i], 0, 10);
+        else if (std::strcmp(arg, "--dt") == 0 && has_value)
+            options.duration = std::strtod(argv[++i], 0);
+        else if (std::strcmp(arg, "--threads") == 0 && has_value)
+            options.threads = std::strtoul(argv[++i], 0, 10);
+        else if (std::strcmp(arg, "--resolver") == 0 && has_value)
+        {
+            const char *mode = argv[++i];
+            if (std::strcmp(mode, "priority") == 0)
+                options.resolver = ParticleContactResolver::PRIORITY;
+            else if (std::strcmp(mode, "pgs") == 0)
+                options.sequential_impulse = true;
+            else if (std::strcmp(mode, "iterative") != 0)
+                return false;
+        }
+        else if (std::strcmp(arg, "--broadphase") == 0 && has_value)
+        {
+            const char *broadphase = argv[++i];
+            if (std::strcmp(broadphase, "sap") == 0)
+                options.sweep_and_prune = true;
+            else if (std::strcmp(broadphase, "hash") != 0)
+                return false;
+        }
+        else if (std::strcmp(arg, "--registry") == 0 && has_value)
+        {
+            const char *registry = argv[++i];
+            if (std::strcmp(registry, "batched") == 0)
+                options.registry = ParticleForceRegistry::BATCHED;
+            else if (std::strcmp(registry, "virtual") != 0)
+                return false;
+        }
+        else if (std::strcmp(arg, "--reorder") == 0 && has_value)
+            options.reorder = std::strtoul(argv[++i], 0, 10);
+        else if (std::strcmp(arg, "--store") == 0)
+            options.use_store = true;
+        else if (arg[0] != '-')
+            options.scenes.push_back(arg);
+        else
+            return false;
+    }
+
+    if (options.scenes.empty())
+        options.scenes = {"bridge", "rope", "rain", "pile", "pegs", "cloth", "fluid", "integrate", "collide", "forces", "fields", "random", "sph"};
+    return options.steps > 0 && options.size > 0;
+}
+
+static std::unique_ptr<Scene> make_scene(const std::string &name, const Options &options)
+{
+    if (name == "bridge")
+        return std::unique_ptr<Scene>(new BridgeScene(options.size, options.use_store));
+    if (name == "rope")
+        return std::unique_ptr<Scene>(new RopeScene(options.size, options.use_store));
+    if (name == "rain")
+        return std::unique_ptr<Scene>(new RainScene(options.size, options.use_store));
+    if (name == "cloth")
+        return std::unique_ptr<Scene>(new ClothScene(options.size, options.use_store));
+    if (name == "pegs")
+        return std::unique_ptr<Scene>(new PegScene(options.size, options.use_store));
+    if (name == "pile")
+        return std::unique_ptr<Scene>(new PileScene(options.size, options.use_store, options.sweep_and_prune));
+    if (name == "fluid")
+        return std::unique_ptr<Scene>(new FluidScene(options.size));
+    return nullptr;
+}
+
+static void run_scene(Scene &scene, const Options &options)
+{
+    typedef std::chrono::steady_clock clock;
+
+    static bool printed_header = false;
+    if (!printed_header)
+    {
+        std::printf("%-8s %10s %12s %12s %14s %14s %10s %10s\n",
+                    "scene", "particles", "contacts", "steps/sec", "ns/particle", "ns/contact", "peak", "arena");
+        printed_header = true;
+    }
+
+    // let the scene settle so the first frames dont dominate the contact count
+    for (unsigned i = 0; i < options.steps / 10; i++)
+        scene.step(options.duration);
+
+    unsigned long long contacts = 0;
+    clock::time_point start = clock::now();
+    for (unsigned i = 0; i < options.steps; i++)
+    {
+        scene.step(options.duration);
+        contacts += scene.get_world().get_contact_count();
+    }
+    double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    unsigned particles = scene.particle_count();
+    double steps_per_sec = options.steps / (ns * 1e-9);
+    double ns_per_particle = ns / (double(options.steps) * particles);
+    double ns_per_contact = contacts ? ns / double(contacts) : 0.0;
+
+    const ParticleWorld::ContactStats &stats = scene.get_world().get_contact_stats();
+    std::printf("%-8s %10u %12.1f %12.1f %14.2f %14.2f %10u %10u\n",
+                scene.name(), particles, double(contacts) / options.steps,
+                steps_per_sec, ns_per_particle, ns_per_contact, stats.high_water, stats.capacity);
+}
+
+static void fill_store(ParticleStore &store, unsigned count)
+{
+    unsigned seed = 4321;
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned slot = store.get_slot(store.create());
+        store.set_position(slot, Vector3(next_unit(seed), next_unit(seed), next_unit(seed)) * 100);
+        store.set_velocity(slot, Vector3(next_unit(seed), next_unit(seed), next_unit(seed)) * 10);
+        store.set_acceleration(slot, Vector3::GRAVITY);
+        store.inverse_mass[slot] = next_unit(seed) + 0.5f;
+        // first half shares one damping value, second half exercises the per lane pow
+        store.damping[slot] = i < count / 2 ? 0.99f : 0.9f + next_unit(seed) * 0.1f;
+    }
+}
+
+static real relative_error(const std::vector<real> &a, const std::vector<real> &b)
+{
+    real max_error = 0;
+    for (unsigned i = 0; i < a.size(); i++)
+    {
+        real scale = real_abs(a[i]) > 1 ? real_abs(a[i]) : 1;
+        real error = real_abs(a[i] - b[i]) / scale;
+        if (error > max_error)
+            max_error = error;
+    }
+    return max_error;
+}
+
+// compares ParticleStore::integrate against ParticleStore::integrate_batch on the same particles
+// returns false when the two drift further apart than rounding explains
+static bool run_integrate(const Options &options)
+{
+    typedef std::chrono::steady_clock clock;
+
+    ParticleStore scalar, batch;
+    fill_store(scalar, options.size);
+    fill_store(batch, options.size);
+
+    clock::time_point start = clock::now();
+    for (unsigned i = 0; i < options.steps; i++)
+    {
+        scalar.add_force(0, Vector3::UP);
+        scalar.integrate(options.duration);
+    }
+    double scalar_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    start = clock::now();
+    for (unsigned i = 0; i < options.steps; i++)
+    {
+        batch.add_force(0, Vector3::UP);
+        batch.integrate_batch(options.duration);
+    }
+    double batch_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    real error = relative_error(scalar.position_x, batch.position_x);
+    real velocity_error = relative_error(scalar.velocity_y, batch.velocity_y);
+    if (velocity_error > error)
+        error = velocity_error;
+
+    double samples = double(options.steps) * options.size;
+    std::printf("\n%-10s %10s %14s %14s %10s %12s\n",
+                "integrate", "particles", "scalar ns/p", "batch ns/p", "speedup", "max rel err");
+    std::printf("%-10s %10u %14.3f %14.3f %9.2fx %12.3g\n",
+                "simd", options.size, scalar_ns / samples, batch_ns / samples, scalar_ns / batch_ns, double(error));
+
+    const real tolerance = 1e-4f;
+    if (error > tolerance)
+    {
+        std::fprintf(stderr, "integrate_batch differs from integrate by %g\n", double(error));
+        return false;
+    }
+    return true;
+}
+
+// the pairs a ParticleCollisionGenerator should find, by testing every pair
+static unsigned count_overlaps(const std::vector<Particle> &particles, const std::vector<real> &radii)
+{
+    unsigned overlaps = 0;
+    for (unsigned i = 0; i < particles.size(); i++)
+    {
+        for (unsigned j = i + 1; j < particles.size(); j++)
+        {
+            real reach = radii[i] + radii[j];
+            Vector3 offset = particles[i].get_position() - particles[j].get_position();
+            if (offset.sqare_magnitude() < reach * reach)
+                overlaps++;
+        }
+    }
+    return overlaps;
+}
+
+// true when compact holds contacts as pairs, in the same order and with the normals packed
+static bool same_contacts(const ParticleContact *contacts, unsigned count, const ParticleCompactContacts &compact)
+{
+    if (compact.pairs.size() != count || compact.scenery.size() != 0)
+        return false;
+
+    const ParticleStore *store = compact.get_store();
+    for (unsigned i = 0; i < count; i++)
+    {
+        const ParticleContact &contact = contacts[i];
+        Vector3 normal = ParticleCompactContacts::unpack_normal(compact.pairs.normal[i]);
+        if (compact.pairs.first[i] != store->get_slot(contact.particle[0]->get_handle()) ||
+            compact.pairs.second[i] != store->get_slot(contact.particle[1]->get_handle()) ||
+            (normal - contact.contact_normal).magnitude() > real(1e-3f) ||
+            compact.pairs.penetration[i] != contact.penetration)
+            return false;
+    }
+    return true;
+}
+
+// times each broadphase collision generator against the all pairs loop on the same particles
+// returns false when a broadphase misses or invents a contact
+static bool run_collide(const Options &options)
+{
+    typedef std::chrono::steady_clock clock;
+
+    std::vector<Particle> particles(options.size);
+    std::vector<real> radii(options.size);
+    ParticleWorld::Particles pointers;
+
+    // dense enough that most particles touch a few others
+    const real extent = real_sqrt(real(options.size)) * 2;
+    unsigned seed = 2468;
+    for (unsigned i = 0; i < options.size; i++)
+    {
+        particles[i].set_position(next_unit(seed) * extent, next_unit(seed) * extent, next_unit(seed) * 4);
+        radii[i] = 0.5f + next_unit(seed) * 0.5f;
+        pointers.push_back(&particles[i]);
+    }
+
+    const unsigned limit = options.size * 32;
+    std::vector<ParticleContact> contacts(limit);
+
+    ParticleHashCollisions hash;
+    ParticleSweepCollisions sweep;
+    ParticleTreeCollisions tree;
+    ParticleCollisionGenerator *generators[3] = {&hash, &sweep, &tree};
+    const char *generator_names[3] = {"hash", "sap", "tree"};
+    unsigned generator_contacts[3], rerun_contacts[3];
+    double generator_ns[3], compact_ns[3];
+    bool compact_same[3];
+    ParticleCompactContacts compact;
+
+    for (unsigned g = 0; g < 3; g++)
+    {
+        generators[g]->init(&pointers, 1, 0);
+        generators[g]->set_radii(&radii);
+
+        clock::time_point start = clock::now();
+        for (unsigned i = 0; i < options.steps; i++)
+            generator_contacts[g] = generators[g]->add_contact(contacts.data(), limit);
+        generator_ns[g] = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+        // ParticleWorld runs a generator again when it fills its room, the clipped call mustnt change what the next finds
+        generators[g]->add_contact(contacts.data(), generator_contacts[g] / 2 + 1);
+        rerun_contacts[g] = generators[g]->add_contact(contacts.data(), limit);
+
+        start = clock::now();
+        for (unsigned i = 0; i < options.steps; i++)
+        {
+            compact.clear();
+            generators[g]->add_contacts(compact, limit);
+        }
+        compact_ns[g] = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        compact_same[g] = same_contacts(contacts.data(), rerun_contacts[g], compact);
+    }
+
+    // the all pairs loop is quadratic, a handful of runs is enough to time it
+    const unsigned brute_steps = options.steps < 10 ? options.steps : 10;
+    unsigned brute_contacts = 0;
+    clock::time_point start = clock::now();
+    for (unsigned i = 0; i < brute_steps; i++)
+        brute_contacts = count_overlaps(particles, radii);
+    double brute_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    double brute_per_step = brute_ns / brute_steps;
+    std::printf("\n%-10s %10s %12s %14s %14s %10s %12s\n",
+                "collide", "particles", "contacts", "all pairs us", "broadphase us", "speedup", "compact us");
+
+    bool ok = true;
+    for (unsigned g = 0; g < 3; g++)
+    {
+        double per_step = generator_ns[g] / options.steps;
+        std::printf("%-10s %10u %12u %14.1f %14.1f %9.2fx %12.1f\n",
+                    generator_names[g], options.size, generator_contacts[g], brute_per_step * 1e-3, per_step * 1e-3, brute_per_step / per_step,
+                    compact_ns[g] / options.steps * 1e-3);
+
+        if (generator_contacts[g] != brute_contacts)
+        {
+            std::fprintf(stderr, "%s broadphase found %u contacts, all pairs found %u\n", generator_names[g], generator_contacts[g], brute_contacts);
+            ok = false;
+        }
+        if (rerun_contacts[g] != generator_contacts[g])
+        {
+            std::fprintf(stderr, "%s broadphase found %u contacts when run again after filling a smaller limit, %u before\n",
+                         generator_names[g], rerun_contacts[g], generator_contacts[g]);
+            ok = false;
+        }
+        if (!compact_same[g])
+        {
+            std::fprintf(stderr, "%s broadphase wrote different contacts through add_contacts\n", generator_names[g]);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// every built in force generator registered over store backed particles
+struct ForceSetup
+{
+    ParticleStore store;
+    std::vector<Particle> particles;
+    Vector3 anchor;
+    ParticleGravity gravity;
+    ParticleDrag drag;
+    ParticleBuoyancy buoyancy;
+    std::vector<ParticleSpring> springs;
+    std::vector<ParticleAnchoredSpring> anchored_springs;
+    std::vector<ParticleBungee> bungees;
+    ParticleForceRegistry registry;
+
+    ForceSetup(unsigned count, ParticleForceRegistry::Mode mode)
+        : anchor(0, 50, 0), gravity(Vector3(0, -9.81f, 1)), drag(0.1f, 0.01f), buoyancy(2, 0.1f, 25)
+    {
+        fill_store(store, count);
+        for (unsigned i = 0; i < count; i++)
+            particles.push_back(Particle(&store, store.get_handle(i)));
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            springs.push_back(ParticleSpring(&particles[(i + 1) % count], 20, 2));
+            anchored_springs.push_back(ParticleAnchoredSpring(&anchor, 5, 10));
+            bungees.push_back(ParticleBungee(&particles[(i + 7) % count], 10, 3));
+        }
+
+        registry.set_mode(mode);
+        for (unsigned i = 0; i < count; i++)
+            register_particle(i);
+    }
+
+    void register_particle(unsigned i)
+    {
+        registry.add(&particles[i], &gravity);
+        registry.add(&particles[i], &drag);
+        registry.add(&particles[i], &buoyancy);
+        registry.add(&particles[i], &springs[i]);
+        registry.add(&particles[i], &anchored_springs[i]);
+        registry.add(&particles[i], &bungees[i]);
+    }
+
+    // with churn 1% of the particles lose and regain all their registrations every step, like despawning and respawning
+    double time(const Options &options, bool churn)
+    {
+        typedef std::chrono::steady_clock clock;
+
+        unsigned next = 0;
+        unsigned churned = particles.size() / 100;
+        clock::time_point start = clock::now();
+        for (unsigned i = 0; i < options.steps; i++)
+        {
+            for (unsigned c = 0; churn && c < churned; c++)
+            {
+                registry.remove_particle(&particles[next]);
+                register_particle(next);
+                next = (next + 1) % particles.size();
+            }
+
+            store.clear_accumulators();
+            registry.update_forces(options.duration);
+        }
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    }
+};
+
+// times ParticleForceRegistry in virtual mode against batched mode on the same registrations, then again
+// while registrations are removed and added every step
+// returns false when the two modes push the particles differently
+static bool run_forces(const Options &options)
+{
+    ForceSetup virtual_setup(options.size, ParticleForceRegistry::VIRTUAL);
+    ForceSetup batched_setup(options.size, ParticleForceRegistry::BATCHED);
+
+    bool ok = true;
+    double samples = double(options.steps) * options.size * 6;
+    std::printf("\n%-10s %10s %14s %14s %10s %12s\n",
+                "forces", "registered", "virtual ns/r", "batched ns/r", "speedup", "max rel err");
+
+    for (unsigned churn = 0; churn < 2; churn++)
+    {
+        double virtual_ns = virtual_setup.time(options, churn);
+        double batched_ns = batched_setup.time(options, churn);
+
+        real error = relative_error(virtual_setup.store.force_x, batched_setup.store.force_x);
+        real y_error = relative_error(virtual_setup.store.force_y, batched_setup.store.force_y);
+        if (y_error > error)
+            error = y_error;
+
+        std::printf("%-10s %10u %14.3f %14.3f %9.2fx %12.3g\n",
+                    churn ? "churn" : "registry", virtual_setup.registry.size(), virtual_ns / samples, batched_ns / samples, virtual_ns / batched_ns, double(error));
+
+        // batches add each particle's forces in a different order so rounding differs more than for integrate
+        const real tolerance = 1e-3f;
+        if (error > tolerance)
+        {
+            std::fprintf(stderr, "batched registry differs from virtual registry by %g\n", double(error));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// gravity, drag and buoyancy registered per particle against the same pushes from world force fields
+// buoyancy only reaches the particles on the second layer, to exercise the masks
+struct FieldSetup
+{
+    ParticleWorld world;
+    std::vector<Particle> particles;
+    ParticleGravity gravity;
+    ParticleDrag drag;
+    ParticleBuoyancy buoyancy;
+    ParticleGravityField gravity_field;
+    ParticleDragField drag_field;
+    ParticleBuoyancyField buoyancy_field;
+    bool fields;
+
+    FieldSetup(unsigned count, bool fields)
+        : world(1), gravity(Vector3(0, -9.81f, 1)), drag(0.1f, 0.01f), buoyancy(2, 0.1f, 25),
+          gravity_field(Vector3(0, -9.81f, 1)), drag_field(0.1f, 0.01f), buoyancy_field(2, 0.1f, 25), fields(fields)
+    {
+        ParticleStore &store = world.get_particle_store();
+        fill_store(store, count);
+        particles.reserve(count);
+        for (unsigned i = 0; i < count; i++)
+        {
+            particles.push_back(Particle(&store, store.get_handle(i)));
+            particles[i].set_layers(i % 2 ? 3 : 1);
+            world.get_particles().push_back(&particles[i]);
+        }
+
+        buoyancy_field.mask = 2;
+        if (fields)
+        {
+            world.get_force_fields().push_back(&gravity_field);
+            world.get_force_fields().push_back(&drag_field);
+            world.get_force_fields().push_back(&buoyancy_field);
+            return;
+        }
+
+        ParticleForceRegistry &registry = world.get_force_registry();
+        registry.set_mode(ParticleForceRegistry::BATCHED);
+        for (unsigned i = 0; i < count; i++)
+        {
+            registry.add(&particles[i], &gravity);
+            registry.add(&particles[i], &drag);
+            if (i % 2)
+                registry.add(&particles[i], &buoyancy);
+        }
+    }
+
+    double time(const Options &options)
+    {
+        typedef std::chrono::steady_clock clock;
+
+        clock::time_point start = clock::now();
+        for (unsigned i = 0; i < options.steps; i++)
+        {
+            world.get_particle_store().clear_accumulators();
+            if (fields)
+                world.apply_force_fields(options.duration);
+            else
+                world.get_force_registry().update_forces(options.duration);
+        }
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    }
+};
+
+// times registered generators in batched mode against world force fields pushing the same particles
+// returns false when the two push the particles differently
+static bool run_fields(const Options &options)
+{
+    FieldSetup registered_setup(options.size, false);
+    FieldSetup field_setup(options.size, true);
+    field_setup.world.set_thread_count(options.threads);
+
+    double samples = double(options.steps) * options.size;
+    double registered_ns = registered_setup.time(options);
+    double field_ns = field_setup.time(options);
+
+    const ParticleStore &registered = registered_setup.world.get_particle_store();
+    const ParticleStore &field = field_setup.world.get_particle_store();
+    real error = relative_error(registered.force_x, field.force_x);
+    real y_error = relative_error(registered.force_y, field.force_y);
+    if (y_error > error)
+        error = y_error;
+
+    std::printf("\n%-10s %10s %14s %14s %10s %12s\n",
+                "fields", "particles", "registry ns/p", "fields ns/p", "speedup", "max rel err");
+    std::printf("%-10s %10u %14.3f %14.3f %9.2fx %12.3g\n",
+                "store", options.size, registered_ns / samples, field_ns / samples, registered_ns / field_ns, double(error));
+
+    const real tolerance = 1e-3f;
+    if (error > tolerance)
+    {
+        std::fprintf(stderr, "force fields differ from registered generators by %g\n", double(error));
+        return false;
+    }
+    return true;
+}
+
+// what Vector3::get_random did before it kept a generator, seed a fresh mt19937_64 from random_device every call
+static Vector3 reseeded_random()
+{
+    std::mt19937_64 gen{std::random_device()()};
+    std::uniform_real_distribution<double> dis{0.0, 1.0};
+
+    Vector3 vec = Vector3(dis(gen), dis(gen), dis(gen));
+    vec.normalize();
+    return vec;
+}
+
+// times random directions reseeding every call against the cached and the seeded generators
+// returns false when a seed doesnt replay the same vectors or one of them isnt unit length
+static bool run_random(const Options &options)
+{
+    typedef std::chrono::steady_clock clock;
+
+    const unsigned count = options.size;
+    std::vector<Vector3> vectors(count);
+    double sink = 0;
+
+    clock::time_point start = clock::now();
+    for (unsigned i = 0; i < count; i++)
+        sink += double(reseeded_random().x);
+    double reseeded_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    start = clock::now();
+    for (unsigned i = 0; i < count; i++)
+        sink += double(Vector3::get_random().x);
+    double cached_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    Random random(options.size);
+    start = clock::now();
+    random.unit_vectors(vectors.data(), count);
+    double batch_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    // the batch and one at a time each replayed from the same seed
+    bool ok = true;
+    std::vector<Vector3> replayed(count);
+    Random replay(options.size);
+    replay.unit_vectors(replayed.data(), count);
+    Random single(options.size), single_replay(options.size);
+    for (unsigned i = 0; i < count; i++)
+    {
+        Vector3 again = replayed[i];
+        Vector3 one = single.unit_vector(), one_again = single_replay.unit_vector();
+        if (again.x != vectors[i].x || again.y != vectors[i].y || again.z != vectors[i].z ||
+            one.x != one_again.x || one.y != one_again.y || one.z != one_again.z ||
+            real_abs(vectors[i].magnitude() - 1) > real(1e-3f) || real_abs(one.magnitude() - 1) > real(1e-3f))
+            ok = false;
+    }
+
+    std::printf("\n%-10s %10s %14s %14s %14s %10s\n",
+                "random", "vectors", "reseed ns/v", "cached ns/v", "unit ns/v", "speedup");
+    std::printf("%-10s %10u %14.1f %14.1f %14.1f %9.1fx\n",
+                "xoshiro", count, reseeded_ns / count, cached_ns / count, batch_ns / count, reseeded_ns / cached_ns);
+    // keeps the timed loops from being optimised out
+    if (sink == 0.5)
+        std::printf(" ");
+
+    if (!ok)
+        std::fprintf(stderr, "seeded unit vectors didnt replay or werent unit length\n");
+    return ok;
+}
+
+// how far a falls below the ground and overlaps b, both with unit radius, the ground at y = 0
+static real measure_penetration(const Particle &a, const Particle &b)
+{
+    real ground = 1 - a.get_position().y;
+    real overlap = 2 - (a.get_position() - b.get_position()).magnitude();
+    return (ground > 0 ? ground : 0) + (overlap > 0 ? overlap : 0);
+}
+
+static const char *contact_resolver_names[4] = {"iterative", "priority", "pgs", "compact"};
+
+// contact_resolver_names[resolver] on the contacts, fresh each time so nothing is warm started
+static void resolve_with(unsigned resolver, ParticleContact *contacts, unsigned count, real duration)
+{
+    if (resolver == 2)
+    {
+        ParticleContactSolver solver;
+        solver.solve_contacts(contacts, count, duration);
+        return;
+    }
+    if (resolver == 3)
+    {
+        ParticleCompactContacts table;
+        for (unsigned i = 0; i < count; i++)
+            table.add(contacts[i]);
+        ParticleContactResolver resolve(4);
+        resolve.resolve_contacts(table, duration);
+        return;
+    }
+
+    ParticleContactResolver resolve(4, resolver == 0 ? ParticleContactResolver::ITERATIVE : ParticleContactResolver::PRIORITY);
+    resolve.resolve_contacts(contacts, count, duration);
+}
+
+// unit mass particles with no damping or acceleration
+static void make_contact_particle(Particle &p, const Vector3 &position, const Vector3 &velocity)
+{
+    p.set_position(position);
+    p.set_velocity(velocity);
+    p.set_mass(1);
+    p.set_damping(1);
+    p.set_acceleration(Vector3(0, 0, 0));
+}
+
+// resolves a particle sinking into the ground and into a second particle, then a stretched rod, with each resolver
+// returns false when any of them leaves the particles penetrating or the rod off its length
+static bool run_contacts(const Options &options)
+{
+    bool ok = true;
+
+    std::printf("\n%-10s %10s %12s %12s\n", "contacts", "resolver", "before", "after");
+    for (unsigned resolver = 0; resolver < 4; resolver++)
+    {
+        Particle a, b;
+        make_contact_particle(a, Vector3(0, real(0.5f), 0), Vector3(1, -1, 0));
+        make_contact_particle(b, Vector3(real(1.5f), real(0.5f), 0), Vector3(-1, 0, 0));
+
+        // normals point the way particle 0 has to move to get out
+        ParticleContact contacts[2];
+        contacts[0].particle[0] = &a;
+        contacts[0].particle[1] = 0;
+        contacts[0].contact_normal = Vector3::UP;
+        contacts[0].penetration = 1 - a.get_position().y;
+        contacts[0].restitution = 0;
+        Vector3 normal = a.get_position() - b.get_position();
+        normal.normalize();
+        contacts[1].particle[0] = &a;
+        contacts[1].particle[1] = &b;
+        contacts[1].contact_normal = normal;
+        contacts[1].penetration = 2 - (a.get_position() - b.get_position()).magnitude();
+        contacts[1].restitution = 0;
+
+        real before = measure_penetration(a, b);
+        resolve_with(resolver, contacts, 2, options.duration);
+        real after = measure_penetration(a, b);
+
+        std::printf("%-10s %10s %12.4f %12.4f\n", "overlap", contact_resolver_names[resolver], double(before), double(after));
+        if (after > real(1e-3f))
+        {
+            std::fprintf(stderr, "%s resolver left the particles %.4f deep\n", contact_resolver_names[resolver], double(after));
+            ok = false;
+        }
+    }
+
+    for (unsigned resolver = 0; resolver < 4; resolver++)
+    {
+        Particle a, b;
+        make_contact_particle(a, Vector3(0, 0, 0), Vector3(-1, 0, 0));
+        make_contact_particle(b, Vector3(3, 0, 0), Vector3(1, 0, 0));
+
+        ParticleRod rod;
+        rod.particle[0] = &a;
+        rod.particle[1] = &b;
+        rod.length = 2;
+
+        real before = real_abs((a.get_position() - b.get_position()).magnitude() - rod.length);
+        ParticleContact contact;
+        unsigned used = rod.add_contact(&contact, 1);
+        resolve_with(resolver, &contact, used, options.duration);
+        real after = real_abs((a.get_position() - b.get_position()).magnitude() - rod.length);
+
+        std::printf("%-10s %10s %12.4f %12.4f\n", "rod", contact_resolver_names[resolver], double(before), double(after));
+        if (after > real(1e-3f))
+        {
+            std::fprintf(stderr, "%s resolver left the rod %.4f off its length\n", contact_resolver_names[resolver], double(after));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// every pair tested, the WaterSim way, with the same kernel and pressure as SphFluid
+static void brute_force_sph(ParticleStore &store, real radius, real target_density, real stiffness, real viscosity,
+                            std::vector<real> &densities)
+{
+    const SphSpikyKernel<3> kernel(radius);
+    const unsigned count = store.size();
+
+    std::vector<real> masses(count), pressures(count);
+    for (unsigned i = 0; i < count; i++)
+        masses[i] = store.inverse_mass[i] > 0 ? 1 / store.inverse_mass[i] : 0;
+
+    densities.assign(count, 0);
+    for (unsigned i = 0; i < count; i++)
+    {
+        for (unsigned j = 0; j < count; j++)
+            densities[i] += masses[j] * kernel.value((store.get_position(j) - store.get_position(i)).magnitude());
+        pressures[i] = (densities[i] - target_density) * stiffness;
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        Vector3 pressure_force, viscosity_force;
+        for (unsigned j = 0; j < count; j++)
+        {
+            Vector3 offset = store.get_position(j) - store.get_position(i);
+            real distance = offset.magnitude();
+            if (i == j || distance >= radius)
+                continue;
+
+            Vector3 direction = distance > 0 ? offset * (1 / distance) : sph_coincident_direction(i, j);
+            real volume = masses[j] / densities[j];
+            pressure_force.add_scaled_vector(direction, (pressures[i] + pressures[j]) / 2 * kernel.derivative(distance) * volume);
+            viscosity_force.add_scaled_vector(store.get_velocity(j) - store.get_velocity(i), kernel.value(distance) * volume);
+        }
+
+        Vector3 acceleration = pressure_force * (1 / densities[i]);
+        acceleration.add_scaled_vector(viscosity_force, viscosity);
+        store.add_force(i, acceleration * masses[i]);
+    }
+}
+
+// one SphFluid::apply timed over repeats, with its densities and forces put back in creation order to compare
+struct SphRun
+{
+    double ns;
+    double neighbours;
+    std::vector<real> densities;
+    std::vector<real> force[3];
+};
+
+static SphRun time_sph(ParticleStore &store, SphFluid<SphSpikyKernel<3>> &fluid, JobPool *jobs, unsigned repeats)
+{
+    typedef std::chrono::steady_clock clock;
+
+    clock::time_point start = clock::now();
+    for (unsigned i = 0; i < repeats; i++)
+    {
+        store.clear_accumulators();
+        fluid.apply(store, jobs);
+    }
+
+    SphRun run;
+    run.ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / repeats;
+
+    const unsigned count = store.size();
+    unsigned long long neighbours = 0;
+    run.densities.resize(count);
+    for (unsigned axis = 0; axis < 3; axis++)
+        run.force[axis].resize(count);
+    for (unsigned slot = 0; slot < count; slot++)
+    {
+        // handles are handed out in creation order and never reused here
+        unsigned handle = store.get_handle(slot);
+        neighbours += fluid.get_neighbours().count(slot);
+        run.densities[handle] = fluid.get_densities()[slot];
+        run.force[0][handle] = store.force_x[slot];
+        run.force[1][handle] = store.force_y[slot];
+        run.force[2][handle] = store.force_z[slot];
+    }
+    run.neighbours = double(neighbours) / count;
+    return run;
+}
+
+// times SphFluid's grid neighbour lists against testing every pair on a jittered block of fluid
+// the particles are created in shuffled order like a fluid that has mixed, then timed again after ParticleStore::sort_spatially
+// returns false when the densities or forces differ by more than rounding
+static bool run_sph(const Options &options)
+{
+    typedef std::chrono::steady_clock clock;
+
+    const unsigned count = options.size;
+    const real radius = 1, target_density = 1, stiffness = 20, viscosity = 0.1f;
+
+    unsigned seed = 2468;
+    std::vector<unsigned> order(count);
+    for (unsigned i = 0; i < count; i++)
+        order[i] = i;
+    for (unsigned i = count; i > 1; i--)
+        std::swap(order[i - 1], order[unsigned(double(next_unit(seed)) * i)]);
+
+    // about 30 neighbours each, like a settled 3d fluid
+    ParticleStore brute, grid;
+    unsigned side = 1;
+    while (side * side * side < count)
+        side++;
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned cell = order[i];
+        Vector3 position(real(cell % side) + next_unit(seed), real(cell / side % side) + next_unit(seed), real(cell / (side * side)) + next_unit(seed));
+        Vector3 velocity(next_unit(seed), next_unit(seed), next_unit(seed));
+        real inverse_mass = next_unit(seed) + 0.5f;
+        for (ParticleStore *store : {&brute, &grid})
+        {
+            unsigned slot = store->get_slot(store->create());
+            store->set_position(slot, position * 0.5f);
+            store->set_velocity(slot, velocity);
+            store->inverse_mass[slot] = inverse_mass;
+        }
+    }
+
+    std::vector<real> brute_densities;
+    clock::time_point start = clock::now();
+    brute_force_sph(brute, radius, target_density, stiffness, viscosity, brute_densities);
+    double brute_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    JobPool jobs(options.threads);
+    SphFluid<SphSpikyKernel<3>> fluid(radius, target_density, stiffness, viscosity);
+    const unsigned repeats = options.steps / 10 + 1;
+    SphRun shuffled = time_sph(grid, fluid, options.threads > 1 ? &jobs : 0, repeats);
+
+    start = clock::now();
+    grid.sort_spatially(radius);
+    double sort_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    SphRun sorted = time_sph(grid, fluid, options.threads > 1 ? &jobs : 0, repeats);
+
+    std::printf("\n%-10s %10s %12s %14s %14s %10s %12s\n",
+                "sph", "particles", "neighbours", "pairs ms", "grid ms", "speedup", "max rel err");
+
+    bool ok = true;
+    const SphRun *runs[2] = {&shuffled, &sorted};
+    for (unsigned r = 0; r < 2; r++)
+    {
+        real error = relative_error(brute_densities, runs[r]->densities);
+        const std::vector<real> *brute_forces[3] = {&brute.force_x, &brute.force_y, &brute.force_z};
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            real axis_error = relative_error(*brute_forces[axis], runs[r]->force[axis]);
+            if (axis_error > error)
+                error = axis_error;
+        }
+
+        std::printf("%-10s %10u %12.1f %14.3f %14.3f %9.1fx %12.3g\n",
+                    r ? "sorted" : "shuffled", count, runs[r]->neighbours, brute_ns * 1e-6, runs[r]->ns * 1e-6, brute_ns / runs[r]->ns, double(error));
+
+        // sums run over neighbours in another order so rounding differs a little
+        const real tolerance = 1e-3f;
+        if (error > tolerance)
+        {
+            std::fprintf(stderr, "sph neighbour lists differ from testing every pair by %g\n", double(error));
+            ok = false;
+        }
+    }
+    std::printf("%-10s %10s %12s %14s %14.3f\n", "sort", "", "", "", sort_ns * 1e-6);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    std::printf("precision %s, simd width %u\n", GABBYPHYSICS_PRECISION_NAME, unsigned(GABBYPHYSICS_SIMD_WIDTH));
+
+    bool ok = true;
+    for (const std::string &name : options.scenes)
+    {
+        if (name == "integrate")
+        {
+            ok = run_integrate(options) && ok;
+            continue;
+        }
+        if (name == "forces")
+        {
+            ok = run_forces(options) && ok;
+            continue;
+        }
+        if (name == "fields")
+        {
+            ok = run_fields(options) && ok;
+            continue;
+        }
+        if (name == "contacts")
+        {
+            ok = run_contacts(options) && ok;
+            continue;
+        }
+        if (name == "random")
+        {
+            ok = run_random(options) && ok;
+            continue;
+        }
+        if (name == "sph")
+        {
+            ok = run_sph(options) && ok;
+            continue;
+        }
+        if (name == "collide")
+        {
+            ok = run_collide(options) && ok;
+            continue;
+        }
+
+        std::unique_ptr<Scene> scene = make_scene(name, options);
+        if (!scene)
+        {
+            std::fprintf(stderr, "unknown scene '%s'\n", name.c_str());
+            usage();
+            return 1;
+        }
+        scene->get_world().set_thread_count(options.threads);
+        scene->get_world().get_contact_resolver().set_mode(options.resolver);
+        scene->get_world().get_force_registry().set_mode(options.registry);
+        // unit cells, about the size of every scene's particles
+        scene->get_world().set_reorder_interval(options.reorder, 1);
+        if (options.sequential_impulse)
+            scene->get_world().set_contact_solver_type(ParticleWorld::SEQUENTIAL_IMPULSE);
+        run_scene(*scene, options);
+    }
+
+    return ok ? 0 : 1;
+}
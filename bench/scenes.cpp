@@ -0,0 +1,319 @@
+#include "scenes.h"
+
+using namespace gabbyphysics;
+using namespace bench;
+
+Scene::Scene(unsigned contacts, bool use_store) : world(contacts), use_store(use_store)
+{
+}
+
+void Scene::add_particles(unsigned count)
+{
+    // the world holds raw pointers so storage must not move after this
+    particles.resize(count);
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (use_store)
+        {
+            ParticleStore &store = world.get_particle_store();
+            particles[i] = Particle(&store, store.create());
+        }
+        particles[i].set_velocity(0, 0, 0);
+        particles[i].set_acceleration(Vector3::GRAVITY);
+        particles[i].set_damping(0.99f);
+        particles[i].set_mass(1);
+        particles[i].clear_accumulator();
+        world.get_particles().push_back(&particles[i]);
+    }
+}
+
+void Scene::step(real duration)
+{
+    world.start_frame();
+    world.run_physics(duration);
+}
+
+ParticleWorld &Scene::get_world()
+{
+    return world;
+}
+
+unsigned Scene::particle_count() const
+{
+    return particles.size();
+}
+
+BridgeScene::BridgeScene(unsigned size, bool use_store) : Scene(size * 10, use_store)
+{
+    const unsigned segments = size < 4 ? 2 : size / 2;
+    add_particles(segments * 2);
+
+    for (unsigned i = 0; i < segments * 2; i++)
+    {
+        particles[i].set_position(real(i / 2) * 2.0f, 40, real(i % 2) * 2.0f);
+    }
+
+    ground.init(&world.get_particles(), segments * 2.0f + 10, 100);
+    world.get_contact_generators().push_back(&ground);
+
+    rods.resize(segments);
+    for (unsigned i = 0; i < segments; i++)
+    {
+        rods[i].particle[0] = &particles[i * 2];
+        rods[i].particle[1] = &particles[i * 2 + 1];
+        rods[i].length = 2;
+        world.get_contact_generators().push_back(&rods[i]);
+    }
+
+    cables.resize((segments - 1) * 2);
+    for (unsigned i = 0; i < cables.size(); i++)
+    {
+        cables[i].particle[0] = &particles[i];
+        cables[i].particle[1] = &particles[i + 2];
+        cables[i].max_length = 1.9f;
+        cables[i].restitution = 0.3f;
+        world.get_contact_generators().push_back(&cables[i]);
+    }
+
+    supports.resize(segments * 2);
+    for (unsigned i = 0; i < supports.size(); i++)
+    {
+        supports[i].particle = &particles[i];
+        supports[i].anchor = Vector3(real(i / 2) * 2.0f, 45, real(i % 2) * 2.0f);
+        supports[i].max_length = 5.0f + real((i / 2) % 8) * 0.5f;
+        supports[i].restitution = 0.5f;
+        world.get_contact_generators().push_back(&supports[i]);
+    }
+}
+
+RopeScene::RopeScene(unsigned size, bool use_store) : Scene(size * 4, use_store)
+{
+    const unsigned links = 16;
+    const unsigned ropes = size < links ? 1 : size / links;
+    add_particles(ropes * links);
+
+    rods.resize(ropes * (links - 1));
+    anchors.resize(ropes);
+    for (unsigned r = 0; r < ropes; r++)
+    {
+        Particle *rope = &particles[r * links];
+        for (unsigned i = 0; i < links; i++)
+        {
+            rope[i].set_position(real(r) * 4.0f, 100 - real(i), 0);
+        }
+        rope[links - 1].set_velocity(5, 0, 0);
+
+        anchors[r].particle = rope;
+        anchors[r].anchor = Vector3(real(r) * 4.0f, 101, 0);
+        anchors[r].length = 1;
+        world.get_contact_generators().push_back(&anchors[r]);
+
+        for (unsigned i = 0; i < links - 1; i++)
+        {
+            ParticleRod &rod = rods[r * (links - 1) + i];
+            rod.particle[0] = &rope[i];
+            rod.particle[1] = &rope[i + 1];
+            rod.length = 1;
+            world.get_contact_generators().push_back(&rod);
+        }
+    }
+}
+
+RainScene::RainScene(unsigned size, bool use_store) : Scene(size * 2, use_store), drag(0.1f, 0.01f)
+{
+    add_particles(size);
+
+    unsigned seed = 12345;
+    for (unsigned i = 0; i < size; i++)
+    {
+        particles[i].set_position(next_unit(seed) * 100, next_unit(seed) * 50, next_unit(seed) * 100);
+        particles[i].set_velocity(0, -next_unit(seed) * 10, 0);
+        world.get_force_registry().add(&particles[i], &drag);
+    }
+
+    ground.init(&world.get_particles(), 100, 100);
+    world.get_contact_generators().push_back(&ground);
+}
+
+PileScene::PileScene(unsigned size, bool use_store, bool sweep_and_prune) : Scene(size * 8, use_store)
+{
+    add_particles(size);
+
+    // the box widens with the particle count so the pile settles a few balls deep
+    const real width = real(size) * 0.1f + 20;
+    radii.resize(size);
+
+    unsigned seed = 777;
+    for (unsigned i = 0; i < size; i++)
+    {
+        radii[i] = 0.5f + next_unit(seed) * 0.5f;
+        particles[i].set_position(next_unit(seed) * width, 10 + next_unit(seed) * 50, next_unit(seed) * 10);
+    }
+
+    ParticleCollisionGenerator *collisions = &hash_collisions;
+    if (sweep_and_prune)
+        collisions = &sweep_collisions;
+    collisions->init(&world.get_particles(), 1, 0.3f);
+    collisions->set_radii(&radii);
+    world.get_contact_generators().push_back(collisions);
+
+    ground.init(&world.get_particles(), width, 100);
+    world.get_contact_generators().push_back(&ground);
+}
+
+PegScene::PegScene(unsigned size, bool use_store) : Scene(size * 8, use_store)
+{
+    add_particles(size);
+
+    // pegs on a staggered grid, every other row shifted by half a column
+    const unsigned columns = 64;
+    const unsigned rows = size * 8 / columns + 1;
+    const real spacing = 3;
+    const real width = columns * spacing;
+    for (unsigned row = 0; row < rows; row++)
+    {
+        for (unsigned column = 0; column < columns; column++)
+        {
+            Vector3 centre(real(column) * spacing + real(row % 2) * spacing * 0.5f, 5 + real(row) * spacing, 0);
+            collisions.add_obstacle(centre - Vector3(0.5f, 0.5f, 1), centre + Vector3(0.5f, 0.5f, 1));
+        }
+    }
+
+    radii.resize(size);
+    unsigned seed = 999;
+    for (unsigned i = 0; i < size; i++)
+    {
+        radii[i] = 0.4f + next_unit(seed) * 0.4f;
+        particles[i].set_position(next_unit(seed) * width, 10 + rows * spacing + next_unit(seed) * 50, 0);
+    }
+
+    collisions.init(&world.get_particles(), 1, 0.3f);
+    collisions.set_radii(&radii);
+    world.get_contact_generators().push_back(&collisions);
+
+    ground.init(&world.get_particles(), width, rows * spacing + 100);
+    world.get_contact_generators().push_back(&ground);
+}
+
+ClothScene::ClothScene(unsigned size, bool use_store) : Scene(size, use_store), drag(0.1f, 0.01f)
+{
+    const unsigned columns = 64;
+    const unsigned rows = size < columns ? 1 : size / columns;
+    add_particles(rows * columns);
+
+    for (unsigned r = 0; r < rows; r++)
+    {
+        for (unsigned c = 0; c < columns; c++)
+        {
+            Particle &particle = particles[r * columns + c];
+            particle.set_position(real(c), 100, real(r));
+            if (r == 0)
+                particle.set_inverse_mass(0);
+        }
+    }
+
+    // springs hold raw pointers to the other end so they all have to exist before registering
+    springs.reserve(rows * columns * 4);
+    for (unsigned r = 0; r < rows; r++)
+    {
+        for (unsigned c = 0; c < columns; c++)
+        {
+            Particle *particle = &particles[r * columns + c];
+            if (c + 1 < columns)
+            {
+                springs.push_back(ParticleSpring(particle + 1, 50, 1));
+                springs.push_back(ParticleSpring(particle, 50, 1));
+            }
+            if (r + 1 < rows)
+            {
+                springs.push_back(ParticleSpring(particle + columns, 50, 1));
+                springs.push_back(ParticleSpring(particle, 50, 1));
+            }
+        }
+    }
+
+    unsigned spring = 0;
+    for (unsigned r = 0; r < rows; r++)
+    {
+        for (unsigned c = 0; c < columns; c++)
+        {
+            Particle *particle = &particles[r * columns + c];
+            if (c + 1 < columns)
+            {
+                world.get_force_registry().add(particle, &springs[spring++]);
+                world.get_force_registry().add(particle + 1, &springs[spring++]);
+            }
+            if (r + 1 < rows)
+            {
+                world.get_force_registry().add(particle, &springs[spring++]);
+                world.get_force_registry().add(particle + columns, &springs[spring++]);
+            }
+            world.get_force_registry().add(particle, &drag);
+        }
+    }
+}
+
+FluidScene::FluidScene(unsigned size) : Scene(0, true), fluid(1, 1, 100, 1)
+{
+    add_particles(size);
+
+    // a block on a lattice half the smoothing radius apart, as tall as it is wide
+    const real spacing = 0.5f;
+    unsigned side = 1;
+    while (side * side * side < size)
+        side++;
+    width = real(side) * spacing * 2;
+
+    for (unsigned i = 0; i < size; i++)
+    {
+        particles[i].set_position(real(i % side) * spacing + 0.25f, real(i / (side * side)) * spacing + 0.25f, real(i / side % side) * spacing + 0.25f);
+        particles[i].set_damping(1);
+    }
+
+    // the packed block is at rest, so its inside sets the target density
+    ParticleStore &store = world.get_particle_store();
+    fluid.apply(store);
+    real rest = 0;
+    for (std::vector<real>::const_iterator density = fluid.get_densities().begin(); density != fluid.get_densities().end(); density++)
+    {
+        if (*density > rest)
+            rest = *density;
+    }
+    fluid.set_target_density(rest);
+    store.clear_accumulators();
+}
+
+void FluidScene::keep_in_box()
+{
+    ParticleStore &store = world.get_particle_store();
+    std::vector<real> *positions[3] = {&store.position_x, &store.position_y, &store.position_z};
+    std::vector<real> *velocities[3] = {&store.velocity_x, &store.velocity_y, &store.velocity_z};
+
+    // open at the top, walls and floor bounce particles back with half their speed
+    for (unsigned axis = 0; axis < 3; axis++)
+    {
+        std::vector<real> &position = *positions[axis];
+        std::vector<real> &velocity = *velocities[axis];
+        for (unsigned i = 0; i < position.size(); i++)
+        {
+            if (position[i] < 0)
+            {
+                position[i] = 0;
+                velocity[i] = velocity[i] * -0.5f;
+            }
+            else if (axis != 1 && position[i] > width)
+            {
+                position[i] = width;
+                velocity[i] = velocity[i] * -0.5f;
+            }
+        }
+    }
+}
+
+void FluidScene::step(real duration)
+{
+    world.start_frame();
+    fluid.apply(world.get_particle_store(), world.get_job_pool());
+    world.run_physics(duration);
+    keep_in_box();
+}
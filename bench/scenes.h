@@ -0,0 +1,136 @@
+#ifndef GABBYPHYSICS_BENCH_SCENES_H
+#define GABBYPHYSICS_BENCH_SCENES_H
+
+#include "gabbyphysics/gabbyphysics.h"
+
+#include "vector"
+
+namespace bench
+{
+    // fixed seed lcg so every run of a scene starts from the same state
+    inline gabbyphysics::real next_unit(unsigned &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return gabbyphysics::real(state >> 8) / gabbyphysics::real(1 << 24);
+    }
+
+    // a scripted scene owning its particles, links and world
+    // size scales the number of particles in the scene
+    // with use_store the particles are views over the world's ParticleStore
+    class Scene
+    {
+    protected:
+        gabbyphysics::ParticleWorld world;
+        std::vector<gabbyphysics::Particle> particles;
+        bool use_store;
+
+        void add_particles(unsigned count);
+
+    public:
+        Scene(unsigned contacts, bool use_store);
+        virtual ~Scene() {}
+
+        virtual const char *name() const = 0;
+        virtual void step(gabbyphysics::real duration);
+
+        gabbyphysics::ParticleWorld &get_world();
+        unsigned particle_count() const;
+    };
+
+    // the bridgesim demo repeated along x: deck particles joined by rods and cables, hung from cable constraints
+    class BridgeScene : public Scene
+    {
+        std::vector<gabbyphysics::ParticleRod> rods;
+        std::vector<gabbyphysics::ParticleCable> cables;
+        std::vector<gabbyphysics::ParticleCableConstraint> supports;
+        gabbyphysics::GroundContacts ground;
+
+    public:
+        BridgeScene(unsigned size, bool use_store);
+
+        virtual const char *name() const { return "bridge"; }
+    };
+
+    // vertical chains of rods hanging from rod constraints, each released with a sideways kick
+    class RopeScene : public Scene
+    {
+        std::vector<gabbyphysics::ParticleRod> rods;
+        std::vector<gabbyphysics::ParticleRodConstraint> anchors;
+
+    public:
+        RopeScene(unsigned size, bool use_store);
+
+        virtual const char *name() const { return "rope"; }
+    };
+
+    // free particles with air drag falling onto the ground contacts of a box
+    class RainScene : public Scene
+    {
+        gabbyphysics::GroundContacts ground;
+        gabbyphysics::ParticleDrag drag;
+
+    public:
+        RainScene(unsigned size, bool use_store);
+
+        virtual const char *name() const { return "rain"; }
+    };
+
+    // balls of mixed radius dropped into a box, colliding with each other through
+    // ParticleHashCollisions or with sweep_and_prune through ParticleSweepCollisions
+    class PileScene : public Scene
+    {
+        std::vector<gabbyphysics::real> radii;
+        gabbyphysics::ParticleHashCollisions hash_collisions;
+        gabbyphysics::ParticleSweepCollisions sweep_collisions;
+        gabbyphysics::GroundContacts ground;
+
+    public:
+        PileScene(unsigned size, bool use_store, bool sweep_and_prune = false);
+
+        virtual const char *name() const { return "pile"; }
+    };
+
+    // balls falling through a board of static pegs, 8 pegs per particle, held in a ParticleTreeCollisions
+    class PegScene : public Scene
+    {
+        std::vector<gabbyphysics::real> radii;
+        gabbyphysics::ParticleTreeCollisions collisions;
+        gabbyphysics::GroundContacts ground;
+
+    public:
+        PegScene(unsigned size, bool use_store);
+
+        virtual const char *name() const { return "pegs"; }
+    };
+
+    // a sheet of particles joined to their neighbours by springs, hung from its pinned top row
+    // every spring is registered from both ends so the force registry holds about 4 springs per particle
+    class ClothScene : public Scene
+    {
+        std::vector<gabbyphysics::ParticleSpring> springs;
+        gabbyphysics::ParticleDrag drag;
+
+    public:
+        ClothScene(unsigned size, bool use_store);
+
+        virtual const char *name() const { return "cloth"; }
+    };
+
+    // a block of SphFluid particles dropped in one corner of a box twice its width, a dam break
+    // the fluid needs the ParticleStore so it always uses one, the walls reflect particles like WaterSim's box
+    class FluidScene : public Scene
+    {
+        gabbyphysics::SphFluid<gabbyphysics::SphSpikyKernel<3>> fluid;
+        gabbyphysics::real width;
+
+        void keep_in_box();
+
+    public:
+        FluidScene(unsigned size);
+
+        virtual const char *name() const { return "fluid"; }
+        virtual void step(gabbyphysics::real duration);
+    };
+}
+
+#endif // !GABBYPHYSICS_BENCH_SCENES_H
@@ -1,23 +1,56 @@
 // @ts-check
-const {spawn} = require("child_process");
+const http = require("http");
+const fs = require("fs");
+const path = require("path");
 
-/**
- * 
- * @param {string} cmd 
- * @param {string[]} args 
- * @returns {ReturnType<typeof spawn>}
- */
-const run = (cmd, args = []) => {
-	const spawn_opts = { "shell": true };
-	console.log("CMD:", cmd, args.flat(), spawn_opts);
-	const p = spawn(cmd, args.flat(), spawn_opts);
-	p.stdout?.on("data", data => process.stdout.write(data));
-	p.stderr?.on("data", data => process.stderr.write(data));
-	p.on("close", code => {
-		if (code !== 0)
-			console.error(cmd, args, "exited with", code);
-	});
-	return p;
-}
+const PORT = 3000;
+const ROOT = __dirname;
+
+/** @type {{ [ext: string]: string }} */
+const MIME_TYPES = {
+	".html": "text/html",
+	".css": "text/css",
+	".js": "text/javascript",
+	".mjs": "text/javascript",
+	".wasm": "application/wasm",
+	".ico": "image/x-icon",
+	".png": "image/png",
+	".svg": "image/svg+xml",
+	".json": "application/json",
+};
+
+// SharedArrayBuffer, which the sim worker hands frames over in, is only there when the page is cross origin isolated
+const HEADERS = {
+	"Cross-Origin-Opener-Policy": "same-origin",
+	"Cross-Origin-Embedder-Policy": "require-corp",
+	"Cache-Control": "no-cache",
+};
 
-run("http-server", ["-p", "3000", "-a", "0.0.0.0", "-c-1", "-d", "false", "-s"]);
+http.createServer((req, res) => {
+	const url = new URL(req.url ?? "/", "http://localhost");
+	let pathname;
+	try {
+		pathname = decodeURIComponent(url.pathname);
+	} catch {
+		res.writeHead(400).end();
+		return;
+	}
+	let file = path.join(ROOT, pathname);
+	// a prefix check would also let through siblings like ROOT2, so anything relative to ROOT that climbs out is refused
+	const relative = path.relative(ROOT, file);
+	if (relative.startsWith("..") || path.isAbsolute(relative)) {
+		res.writeHead(403).end();
+		return;
+	}
+	if (url.pathname.endsWith("/"))
+		file = path.join(file, "index.html");
+
+	fs.readFile(file, (err, data) => {
+		if (err) {
+			res.writeHead(404, HEADERS).end();
+			return;
+		}
+		res.writeHead(200, { ...HEADERS, "Content-Type": MIME_TYPES[path.extname(file)] ?? "application/octet-stream" });
+		res.end(data);
+	});
+}).listen(PORT, "0.0.0.0", () => console.log(`serving ${ROOT} on http://localhost:${PORT}`));
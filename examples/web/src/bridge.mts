@@ -1,7 +1,7 @@
 import { Compass, scale_to_len } from "./components/compass_input.mjs";
 import { ImageButton } from "./components/image_button.mjs";
-import { ElementLoaderCallback } from "./loader.mjs";
-import { cstr_by_ptr } from "./util.mjs";
+import { compile_wasm, ElementLoaderCallback } from "./loader.mjs";
+import { cstr_by_ptr, draw_render_buffer, RenderBufferExports } from "./util.mjs";
 
 export const load = async (load_elems: ElementLoaderCallback, update_timer: (n: number) => void, reset_timer: () => void) => {
     const game_canvas = document.createElement("canvas");
@@ -24,11 +24,8 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     const import_object = {
         env: {
             memory,
-            browser_draw_point,
             browser_log,
-            browser_clear_canvas,
             browser_draw_rect: (...args: any[]) => { },
-            browser_draw_line,
             browser_draw_radial_gradient: () => { }
         },
         // wasi-sdk adds this import namespace when compiling to wasm32-wasi which is default unless --target=wasm32
@@ -47,7 +44,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     };
 
     interface WasmInstance extends WebAssembly.Instance {
-        exports: {
+        exports: RenderBufferExports & {
             spawn_particle: (x: number, y: number) => void;
             update_particles: (delta_time: number) => void;
             draw_particles: () => void;
@@ -62,28 +59,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
             // paint_wall: (x: number, y: number) => void;
         };
     }
-    const wasm = (await WebAssembly.instantiateStreaming(fetch("out/bridgesim.wasm"), import_object)).instance as WasmInstance;
-
-    function browser_draw_point(x: number, y: number, size: number, r: number, g: number, b: number) {
-        if (!ctx) return;
-
-        ctx.beginPath();
-        ctx.arc(x, y, size, 0, 2 * Math.PI);
-        ctx.fillStyle = `rgb(${r}, ${g}, ${b})`;
-        ctx.fill();
-        ctx.closePath();
-    };
-
-    function browser_draw_line(x1: number, y1: number, x2: number, y2: number, r: number, g: number, b: number) {
-        if (!ctx) return;
-
-        ctx.beginPath();
-        ctx.moveTo(x1, y1);
-        ctx.lineTo(x2, y2);
-        ctx.strokeStyle = `rgb(${r}, ${g}, ${b})`;
-        ctx.stroke();
-        ctx.closePath();
-    }
+    const wasm = (await WebAssembly.instantiate(await compile_wasm("bridgesim"), import_object)) as WasmInstance;
 
     function browser_log(log_ptr: number) {
         const buffer = memory.buffer;
@@ -91,12 +67,6 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         console.log(message);
     }
 
-    function browser_clear_canvas() {
-        if (!ctx) return;
-
-        ctx.clearRect(0, 0, game_canvas.width, game_canvas.height);
-    }
-
     let prev_timestamp: number | null = null;
     let started = false;
     let frame_ids: number[] = [];
@@ -109,6 +79,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         if (prev_timestamp !== null) {
             wasm.exports.update_particles((timestamp - prev_timestamp) * SIM_SPEED);
             wasm.exports.draw_particles();
+            draw_render_buffer(ctx!, memory, wasm.exports);
             if (Math.floor(((timestamp - prev_timestamp) / 1000) % 60) === 0)
                 update_timer(timestamp - prev_timestamp);
         }
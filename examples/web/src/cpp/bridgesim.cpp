@@ -179,7 +179,7 @@ void BridgeSim::display()
     {
         Particle *particle = *p;
         const Vector3 &pos = particle->get_position();
-        browser_draw_point(pos.x, pos.y, PARTICLE_RADIUS, 255, 255, 255);
+        render_buffer.point(pos.x, pos.y, PARTICLE_RADIUS, 255, 255, 255);
     }
 
     for (unsigned i = 0; i < ROD_COUNT; i++)
@@ -187,7 +187,7 @@ void BridgeSim::display()
         Particle **particles = rods[i].particle;
         const Vector3 &p0 = particles[0]->get_position();
         const Vector3 &p1 = particles[1]->get_position();
-        browser_draw_line(p0.x, p0.y, p1.x, p1.y, 250, 0, 250);
+        render_buffer.line(p0.x, p0.y, p1.x, p1.y, 250, 0, 250);
     }
 
     for (unsigned i = 0; i < CABLE_COUNT; i++)
@@ -195,17 +195,17 @@ void BridgeSim::display()
         Particle **particles = cables[i].particle;
         const Vector3 &p0 = particles[0]->get_position();
         const Vector3 &p1 = particles[1]->get_position();
-        browser_draw_line(p0.x, p0.y, p1.x, p1.y, 0, 250, 250);
+        render_buffer.line(p0.x, p0.y, p1.x, p1.y, 0, 250, 250);
     }
 
     for (unsigned i = 0; i < SUPPORT_COUNT; i++)
     {
         const Vector3 &p0 = cable_constraints[i].particle->get_position();
         const Vector3 &p1 = cable_constraints[i].anchor;
-        browser_draw_line(p0.x, p0.y, p1.x, p1.y, 130, 130, 130);
+        render_buffer.line(p0.x, p0.y, p1.x, p1.y, 130, 130, 130);
     }
 
-    browser_draw_point(ball_display_pos.x, ball_display_pos.y, 50, 255, 255, 255);
+    render_buffer.point(ball_display_pos.x, ball_display_pos.y, 50, 255, 255, 255);
 }
 
 void BridgeSim::update(real duration)
@@ -249,7 +249,7 @@ void update(real duration)
 
 void display()
 {
-    browser_clear_canvas();
+    render_buffer.clear();
     app->display();
 }
 
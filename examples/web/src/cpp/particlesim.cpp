@@ -111,7 +111,7 @@ extern "C"
 
     export void draw_particles()
     {
-        browser_clear_canvas();
+        render_buffer.clear();
         for (SimParticle *p = particles;
              p < particles + max_particles;
              p++)
@@ -120,7 +120,7 @@ extern "C"
                 continue;
 
             const Vector3 pos = p->get_position();
-            browser_draw_point(pos.x, pos.y, particle_radius, 0, 0, 200);
+            render_buffer.point(pos.x, pos.y, particle_radius, 0, 0, 200);
         }
     }
 
@@ -130,7 +130,6 @@ extern "C"
         if (grid[coords.i][coords.j].type == CellType(solid))
             return;
         create_particle(Vector3(x, y, 0));
-        browser_draw_point(x, y, particle_radius, 0, 0, 200);
     }
 
     export void reset_particles()
@@ -139,6 +138,8 @@ extern "C"
         {
             p = SimParticle();
         }
+        // the last frame's points are gone too, so a redraw before the next draw_particles shows an empty sim
+        render_buffer.clear();
         browser_clear_canvas();
     }
 
@@ -166,6 +167,7 @@ extern "C"
         if (r <= (real)0.0)
             return;
         particle_radius = r;
+        // refills the render buffer at the new radius, js draws it
         draw_particles();
     }
 
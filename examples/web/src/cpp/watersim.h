@@ -2,22 +2,20 @@
 
 class WaterSim
 {
-    gabbyphysics::Particle *particle_array;
-    gabbyphysics::real *densities;
-
-    unsigned *spatial_lookup;
-    unsigned *start_indices;
+    gabbyphysics::ParticleStore store;
+    // views over store, so set_gravity and friends work per particle
+    std::vector<gabbyphysics::Particle> particles;
+    gabbyphysics::SphFluid<gabbyphysics::SphSpikyKernel<2>> fluid;
+    // only in threaded builds, the fluid passes and integration are split across it
+    std::unique_ptr<gabbyphysics::JobPool> jobs;
 
     unsigned num_particles;
+    unsigned frame;
     unsigned world_x;
     unsigned world_y;
 
 public:
-    WaterSim(
-        unsigned num_particles,
-        unsigned world_x, unsigned world_y,
-        gabbyphysics::real (*kernel)(gabbyphysics::real radius, gabbyphysics::real distance));
-    ~WaterSim();
+    WaterSim(unsigned num_particles, unsigned world_x, unsigned world_y);
 
     void update(gabbyphysics::real duration);
 
@@ -27,21 +25,8 @@ public:
 
     void set_damping(gabbyphysics::real damping);
 
-    void update_spatial_lookup(gabbyphysics::real radius);
-
-    void spatial_based_pressure_step(gabbyphysics::Vector3 point, gabbyphysics::real radius, gabbyphysics::real duration);
-
-    gabbyphysics::real calculate_density(
-        gabbyphysics::Vector3 point,
-        gabbyphysics::real (*kernel)(gabbyphysics::real radius, gabbyphysics::real distance));
-
-    gabbyphysics::real calculate_shared_pressure(
-        gabbyphysics::real density_a,
-        gabbyphysics::real density_b,
-        gabbyphysics::real (*density_to_pressure)(gabbyphysics::real density));
+    // 1 runs everything on the calling thread, like ParticleWorld::set_thread_count
+    void set_thread_count(unsigned threads);
 
-    gabbyphysics::Vector3 calculate_pressure_force(
-        int particle_index,
-        gabbyphysics::real (*kernel_derivative)(gabbyphysics::real radius, gabbyphysics::real distance),
-        gabbyphysics::real (*density_to_pressure)(gabbyphysics::real density));
+    const gabbyphysics::ParticleStore &get_store() const;
 };
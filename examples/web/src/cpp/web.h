@@ -5,6 +5,10 @@
 
 #include "gabbyphysics/gabbyphysics.h"
 
+#ifdef _REENTRANT
+#include "atomic"
+#endif
+
 #ifdef DEV_MODE
 constexpr bool dev_mode = true;
 #else
@@ -16,9 +20,7 @@ export extern "C"
 {
     void browser_log(const char *log);
     void browser_clear_canvas();
-    void browser_draw_point(gabbyphysics::real x, gabbyphysics::real y, gabbyphysics::real size, const int r, const int g, const int b);
     void browser_draw_rect(const int x, const int y, const int type, const int cell_w, const int cell_h);
-    void browser_draw_line(gabbyphysics::real x1, gabbyphysics::real y1, gabbyphysics::real x2, gabbyphysics::real y2, const int r, const int g, const int b);
     void browser_draw_radial_gradient(
         gabbyphysics::real x1, gabbyphysics::real y1,
         const int inner_r, const int outer_r,
@@ -43,18 +45,93 @@ void debug_log(const std::string &format, Args... args)
     }
 }
 
+// one point, or one end of a line, as js reads it out of linear memory
+// x, y and size go through a Float32Array and rgba through a Uint32Array over the same 16 bytes
+struct RenderVertex
+{
+    float x;
+    float y;
+    // radius of a point, width of a line
+    float size;
+    // r in the low byte up to a in the high byte
+    unsigned rgba;
+};
+
+// points and lines a sim draws in a frame, collected in linear memory so js draws the whole frame after one call
+// instead of crossing into js once per primitive
+class RenderBuffer
+{
+    std::vector<RenderVertex> points;
+    // two vertices per line
+    std::vector<RenderVertex> lines;
+
+    static RenderVertex vertex(gabbyphysics::real x, gabbyphysics::real y, gabbyphysics::real size, int r, int g, int b, int a)
+    {
+        return {float(x), float(y), float(size), unsigned(r) | unsigned(g) << 8 | unsigned(b) << 16 | unsigned(a) << 24};
+    }
+
+public:
+    // keeps the capacity so steady frames dont allocate
+    void clear()
+    {
+        points.clear();
+        lines.clear();
+    }
+
+    void point(gabbyphysics::real x, gabbyphysics::real y, gabbyphysics::real size, int r, int g, int b, int a = 255)
+    {
+        points.push_back(vertex(x, y, size, r, g, b, a));
+    }
+
+    void line(gabbyphysics::real x1, gabbyphysics::real y1, gabbyphysics::real x2, gabbyphysics::real y2, int r, int g, int b, int a = 255)
+    {
+        lines.push_back(vertex(x1, y1, 1, r, g, b, a));
+        lines.push_back(vertex(x2, y2, 1, r, g, b, a));
+    }
+
+    const RenderVertex *get_points() const { return points.data(); }
+    unsigned get_point_count() const { return points.size(); }
+    const RenderVertex *get_lines() const { return lines.data(); }
+    unsigned get_line_count() const { return lines.size() / 2; }
+};
+
+RenderBuffer render_buffer;
+
+extern "C"
+{
+    // where the last frame's primitives are, valid until the next draw call, see draw_render_buffer in util.mts
+    export const RenderVertex *render_points() { return render_buffer.get_points(); }
+    export unsigned render_point_count() { return render_buffer.get_point_count(); }
+    export const RenderVertex *render_lines() { return render_buffer.get_lines(); }
+    export unsigned render_line_count() { return render_buffer.get_line_count(); }
+}
+
 extern "C"
 {
     // https://github.com/WebAssembly/WASI/blob/main/legacy/application-abi.md and https://github.com/WebAssembly/wasi-libc/blob/main/libc-bottom-half/crt/crt1-reactor.c
     void __wasm_call_ctors(void);
+#ifdef _REENTRANT
+    // sets up the main thread's pthread, threads made later get theirs in wasi_thread_start
+    void __wasi_init_tp(void);
+#endif
     __attribute__((export_name("_initialize"))) void _initialize(void)
     {
+#ifdef _REENTRANT
+        static std::atomic<int> initialized(0);
+        int expected = 0;
+        if (!initialized.compare_exchange_strong(expected, 1))
+        {
+            __builtin_trap();
+        }
+        __wasi_init_tp();
+#else
         static volatile int initialized = 0;
         if (initialized != 0)
         {
             __builtin_trap();
         }
         initialized = 1;
+#endif
         __wasm_call_ctors();
     }
 }
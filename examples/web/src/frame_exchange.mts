@@ -0,0 +1,158 @@
+// render frames handed from a sim worker to the main thread through a SharedArrayBuffer
+// two slots, the worker fills the one that isnt published then flips PUBLISHED to it,
+// the main thread marks the published slot as READING while it draws so the worker never writes under it
+// no dom in here so the node harness can use it too
+
+// RenderVertex in web.h, x y size as f32 then rgba as u32
+export const RENDER_VERTEX_WORDS = 4;
+
+// i32 words at the start of the buffer
+const HeaderWord = {
+    // slot of the newest complete frame, -1 before the first
+    PUBLISHED: 0,
+    // slot the main thread is drawing from, -1 when it isnt
+    READING: 1,
+    // physics steps the worker has run
+    STEPS: 2,
+    // frames the worker couldnt publish because both slots were in use
+    DROPPED: 3,
+    POINT_CAPACITY: 4,
+    LINE_CAPACITY: 5,
+} as const;
+const HEADER_WORDS = 8;
+
+// i32 words at the start of each slot, vertices follow
+const SlotWord = {
+    FRAME: 0,
+    STEP: 1,
+    POINT_COUNT: 2,
+    LINE_COUNT: 3,
+} as const;
+const SLOT_HEADER_WORDS = 4;
+
+// a frame as draw_render_frame in util.mts reads it, views can be longer than the counts
+export interface RenderFrame {
+    // counts up from 1 with every publish
+    frame: number;
+    // the worker's step count when the frame was drawn
+    step: number;
+    point_count: number;
+    line_count: number;
+    point_floats: Float32Array;
+    point_words: Uint32Array;
+    // two vertices per line
+    line_floats: Float32Array;
+    line_words: Uint32Array;
+}
+
+class Slot implements RenderFrame {
+    point_floats: Float32Array;
+    point_words: Uint32Array;
+    line_floats: Float32Array;
+    line_words: Uint32Array;
+
+    private header: Int32Array;
+
+    constructor(buffer: SharedArrayBuffer, offset: number, point_capacity: number, line_capacity: number) {
+        this.header = new Int32Array(buffer, offset, SLOT_HEADER_WORDS);
+        offset += SLOT_HEADER_WORDS * 4;
+        this.point_floats = new Float32Array(buffer, offset, point_capacity * RENDER_VERTEX_WORDS);
+        this.point_words = new Uint32Array(buffer, offset, point_capacity * RENDER_VERTEX_WORDS);
+        offset += point_capacity * RENDER_VERTEX_WORDS * 4;
+        this.line_floats = new Float32Array(buffer, offset, line_capacity * 2 * RENDER_VERTEX_WORDS);
+        this.line_words = new Uint32Array(buffer, offset, line_capacity * 2 * RENDER_VERTEX_WORDS);
+    }
+
+    // plain reads, the PUBLISHED and READING handshake orders them after the worker's writes
+    get frame() { return this.header[SlotWord.FRAME]; }
+    get step() { return this.header[SlotWord.STEP]; }
+    get point_count() { return this.header[SlotWord.POINT_COUNT]; }
+    get line_count() { return this.header[SlotWord.LINE_COUNT]; }
+
+    write(frame: number, step: number, points: Uint32Array, lines: Uint32Array) {
+        // anything past capacity is cut off rather than spilling into the other slot
+        const point_words = Math.min(points.length, this.point_words.length);
+        const line_words = Math.min(lines.length, this.line_words.length);
+        this.point_words.set(point_words < points.length ? points.subarray(0, point_words) : points);
+        this.line_words.set(line_words < lines.length ? lines.subarray(0, line_words) : lines);
+        this.header[SlotWord.FRAME] = frame;
+        this.header[SlotWord.STEP] = step;
+        this.header[SlotWord.POINT_COUNT] = point_words / RENDER_VERTEX_WORDS;
+        this.header[SlotWord.LINE_COUNT] = line_words / (2 * RENDER_VERTEX_WORDS);
+    }
+}
+
+export class FrameExchange {
+    readonly buffer: SharedArrayBuffer;
+    readonly point_capacity: number;
+    readonly line_capacity: number;
+
+    private header: Int32Array;
+    private slots: Slot[];
+    // only used on the writing side
+    private frame = 0;
+
+    // capacities are in points and lines, a frame with more is truncated
+    static create(point_capacity: number, line_capacity: number) {
+        const slot_words = SLOT_HEADER_WORDS + (point_capacity + line_capacity * 2) * RENDER_VERTEX_WORDS;
+        const buffer = new SharedArrayBuffer((HEADER_WORDS + slot_words * 2) * 4);
+        const header = new Int32Array(buffer, 0, HEADER_WORDS);
+        header[HeaderWord.PUBLISHED] = -1;
+        header[HeaderWord.READING] = -1;
+        header[HeaderWord.POINT_CAPACITY] = point_capacity;
+        header[HeaderWord.LINE_CAPACITY] = line_capacity;
+        return new FrameExchange(buffer);
+    }
+
+    // wraps a buffer made by create, on either side of a postMessage
+    constructor(buffer: SharedArrayBuffer) {
+        this.buffer = buffer;
+        this.header = new Int32Array(buffer, 0, HEADER_WORDS);
+        this.point_capacity = this.header[HeaderWord.POINT_CAPACITY];
+        this.line_capacity = this.header[HeaderWord.LINE_CAPACITY];
+
+        const slot_bytes = (SLOT_HEADER_WORDS + (this.point_capacity + this.line_capacity * 2) * RENDER_VERTEX_WORDS) * 4;
+        this.slots = [0, 1].map(i => new Slot(buffer, HEADER_WORDS * 4 + i * slot_bytes, this.point_capacity, this.line_capacity));
+    }
+
+    // worker side, copies the vertex words of a frame into the free slot and publishes it
+    // returns false and drops the frame when the main thread is still drawing from the free slot,
+    // which can only happen when the worker publishes twice during one draw
+    publish(points: Uint32Array, lines: Uint32Array) {
+        const published = Atomics.load(this.header, HeaderWord.PUBLISHED);
+        const target = published === 0 ? 1 : 0;
+        if (Atomics.load(this.header, HeaderWord.READING) === target) {
+            Atomics.add(this.header, HeaderWord.DROPPED, 1);
+            return false;
+        }
+
+        this.slots[target].write(++this.frame, Atomics.load(this.header, HeaderWord.STEPS), points, lines);
+        Atomics.store(this.header, HeaderWord.PUBLISHED, target);
+        return true;
+    }
+
+    add_steps(steps: number) {
+        Atomics.add(this.header, HeaderWord.STEPS, steps);
+    }
+
+    // main thread side, the newest complete frame, kept from the worker until release
+    // null before the worker has published anything
+    acquire(): RenderFrame | null {
+        for (; ;) {
+            const published = Atomics.load(this.header, HeaderWord.PUBLISHED);
+            if (published < 0)
+                return null;
+            Atomics.store(this.header, HeaderWord.READING, published);
+            // the worker flipped between the load and the store and may already be writing this slot, take the new one
+            if (Atomics.load(this.header, HeaderWord.PUBLISHED) === published)
+                return this.slots[published];
+        }
+    }
+
+    release() {
+        Atomics.store(this.header, HeaderWord.READING, -1);
+    }
+
+    get steps() { return Atomics.load(this.header, HeaderWord.STEPS); }
+    get dropped() { return Atomics.load(this.header, HeaderWord.DROPPED); }
+}
@@ -10,12 +10,39 @@ interface Demo {
 
 const available_demos: Demo[] = [
     { name: "Ball Bouncer", description: "Particle ballistics demo. Paint walls, bounce balls.", path: "./particle.mjs" },
-    // { name: "Water Sim", description: "It simulates water.", path: "./watersim.mjs" },
+    { name: "Water Sim", description: "It simulates water.", path: "./watersim.mjs" },
     // { name: "Bridges and Ropes", description: "Create objects out of springlike things", path: "./bridge.mjs" }
 ];
 
 const LAST_DEMO_STORAGE_KEY = "LAST_DEMO";
 
+// SIMD128 support, checked against the smallest module that uses a v128 instruction (i8x16.popcnt of a splat)
+export const wasm_simd = WebAssembly.validate(new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]));
+
+// a sim's builds in out/ best first, the -simd ones from make build only when the browser can run them
+// and the -threads ones from make build-threads only for a sim hosted in a worker
+export function wasm_builds(name: string, threads = false) {
+    const variants = threads ? ["-threads", ""] : [""];
+    return variants.flatMap(variant => wasm_simd ? [`out/${name}${variant}-simd.wasm`, `out/${name}${variant}.wasm`] : [`out/${name}${variant}.wasm`]);
+}
+
+// compiles the first of a sim's builds that loads, so builds that havent been made are skipped
+export async function compile_wasm(name: string, threads = false) {
+    const urls = wasm_builds(name, threads);
+    for (const url of urls.slice(0, -1)) {
+        try {
+            const module = await WebAssembly.compileStreaming(fetch(url));
+            console.log(`loaded ${url}`);
+            return module;
+        } catch (err) {
+            console.log(`couldnt load ${url}, trying the next build`);
+        }
+    }
+    return WebAssembly.compileStreaming(fetch(urls[urls.length - 1]));
+}
+
 (async () => {
     const main = document.getElementById("main");
     if (!main) throw new Error("No module load container 'main' found");
@@ -1,6 +1,6 @@
 import { Compass, scale_to_len } from "./components/compass_input.mjs";
-import { ElementLoaderCallback } from "./loader.mjs";
-import { cstr_by_ptr } from "./util.mjs";
+import { compile_wasm, ElementLoaderCallback } from "./loader.mjs";
+import { cstr_by_ptr, draw_render_buffer, RenderBufferExports } from "./util.mjs";
 
 export const load = async (load_elems: ElementLoaderCallback, update_timer: (n: number) => void, reset_timer: () => void) => {
     const game_canvas = document.createElement("canvas");
@@ -43,7 +43,6 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     const import_object = {
         env: {
             memory,
-            browser_draw_point,
             browser_log,
             browser_clear_canvas,
             browser_draw_rect,
@@ -65,7 +64,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     };
 
     interface WasmInstance extends WebAssembly.Instance {
-        exports: {
+        exports: RenderBufferExports & {
             spawn_particle: (x: number, y: number) => void;
             update_particles: (delta_time: number) => void;
             draw_particles: () => void;
@@ -78,17 +77,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
             paint_wall: (x: number, y: number) => void;
         };
     }
-    const wasm = (await WebAssembly.instantiateStreaming(fetch("out/particlesim.wasm"), import_object)).instance as WasmInstance;
-
-    function browser_draw_point(x: number, y: number, size: number, r: number, g: number, b: number) {
-        if (!ctx) return;
-
-        ctx.beginPath();
-        ctx.arc(x, y, size, 0, 2 * Math.PI);
-        ctx.fillStyle = `rgb(${r}, ${g}, ${b})`;
-        ctx.fill();
-        ctx.closePath();
-    };
+    const wasm = (await WebAssembly.instantiate(await compile_wasm("particlesim"), import_object)) as WasmInstance;
 
     const CellTypeColorMap: { [type: number]: string; } = {
         0: "rgba(0, 1, 200, 0.2)",
@@ -136,6 +125,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         if (prev_timestamp !== null) {
             wasm.exports.update_particles((timestamp - prev_timestamp) * SIM_SPEED);
             wasm.exports.draw_particles();
+            draw_render_buffer(ctx!, memory, wasm.exports);
             if (Math.floor(((timestamp - prev_timestamp) / 1000) % 60) === 0)
                 update_timer(timestamp - prev_timestamp);
         }
@@ -155,6 +145,9 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         switch (click_mode) {
             case "spawn":
                 wasm.exports.spawn_particle(evt.clientX - game_canvas.offsetLeft, evt.clientY - game_canvas.offsetTop);
+                // shows the new particle while the sim is stopped
+                wasm.exports.draw_particles();
+                draw_render_buffer(ctx!, memory, wasm.exports);
                 break;
             case "paint":
                 wasm.exports.paint_wall(evt.clientX - game_canvas.offsetLeft, evt.clientY - game_canvas.offsetTop);
@@ -245,6 +238,8 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         // @ts-ignore
         PARTICLE_RADIUS = evt.target.value;
         wasm.exports.set_particle_radius(PARTICLE_RADIUS);
+        // set_particle_radius refills the render buffer, this shows it while the sim is stopped
+        draw_render_buffer(ctx!, memory, wasm.exports);
     };
     const radius_label = document.createTextNode(`particle radius`);
     container.appendChild(radius_label);
@@ -0,0 +1,101 @@
+// main thread end of sim_worker.mts, the page only draws the newest frame the worker has published
+// so a slow physics step costs simulation rate instead of dropped frames and blocked input
+
+import { FrameExchange, type RenderFrame } from "./frame_exchange.mjs";
+import type { SimWorkerMessage, SimWorkerReply } from "./sim_worker.mjs";
+
+// what SimWorkerHost needs from a Worker, so the node harness can hand it a worker_threads one
+export interface WorkerLike {
+    postMessage(message: any): void;
+    onmessage: ((evt: MessageEvent) => any) | null;
+    terminate(): void;
+}
+
+export interface SimWorkerOptions {
+    // sizes the shared frames, anything past them isnt drawn
+    point_capacity: number;
+    line_capacity?: number;
+    // wall clock time per physics step and how much sim time that is per ms, same units the main thread loops use
+    step_ms?: number;
+    sim_speed?: number;
+}
+
+export class SimWorkerHost {
+    readonly exchange: FrameExchange;
+    private worker: WorkerLike;
+    private ready: Promise<void>;
+
+    // SharedArrayBuffer needs the page to be cross origin isolated, serve.cjs sends the headers for it
+    static supported() {
+        return typeof SharedArrayBuffer !== "undefined" && (typeof crossOriginIsolated === "undefined" || crossOriginIsolated);
+    }
+
+    // the browser worker for sim_worker.mjs
+    static create_worker(): WorkerLike {
+        return new Worker(new URL("./sim_worker.mjs", import.meta.url), { type: "module" });
+    }
+
+    constructor(worker: WorkerLike, module: WebAssembly.Module, options: SimWorkerOptions) {
+        this.worker = worker;
+        this.exchange = FrameExchange.create(options.point_capacity, options.line_capacity ?? 0);
+
+        this.ready = new Promise((resolve, reject) => {
+            worker.onmessage = (evt: MessageEvent<SimWorkerReply>) => {
+                switch (evt.data.type) {
+                    case "ready":
+                        resolve();
+                        break;
+                    case "error":
+                        console.error("sim worker:", evt.data.message);
+                        reject(new Error(evt.data.message));
+                        break;
+                }
+            };
+        });
+
+        this.post({
+            type: "init",
+            module,
+            exchange: this.exchange.buffer,
+            step_ms: options.step_ms ?? 1000 / 60,
+            sim_speed: options.sim_speed ?? 0.01
+        });
+    }
+
+    private post(message: SimWorkerMessage) {
+        this.worker.postMessage(message);
+    }
+
+    // resolves once the module is instantiated in the worker
+    wait_ready() {
+        return this.ready;
+    }
+
+    // calls are queued and run in order between physics steps
+    call(name: string, ...args: number[]) {
+        this.post({ type: "call", name, args });
+    }
+
+    run(running: boolean) {
+        this.post({ type: "run", running });
+    }
+
+    // the newest frame, or null when there isnt one or it was already drawn
+    // the worker doesnt touch it until release, so draw it and release straight away
+    acquire(last_frame = 0): RenderFrame | null {
+        const frame = this.exchange.acquire();
+        if (frame && frame.frame === last_frame) {
+            this.exchange.release();
+            return null;
+        }
+        return frame;
+    }
+
+    release() {
+        this.exchange.release();
+    }
+
+    terminate() {
+        this.worker.terminate();
+    }
+}
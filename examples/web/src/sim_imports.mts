@@ -0,0 +1,64 @@
+// imports for a sim's wasm module off the main thread, in sim_worker.mts and in each of a threaded module's sim_thread.mts
+// drawing is done from the render buffer on the main thread, so the browser_ imports do nothing here
+
+import { cstr_by_ptr } from "./util.mjs";
+
+// the limits the threaded build links with in the Makefile, in 64KiB pages
+// an imported shared memory has to fit inside them
+export const THREADS_MEMORY = { initial: 256, maximum: 4096 };
+
+// what sim_worker.mjs posts to a sim_thread.mjs
+export interface SimThreadStart {
+    module: WebAssembly.Module;
+    memory: WebAssembly.Memory;
+    tid: number;
+    start_arg: number;
+    // one i32 every thread of the module counts thread ids up from
+    next_tid: Int32Array;
+}
+
+// modules built with build-threads import wasi thread-spawn
+export function is_threaded(module: WebAssembly.Module) {
+    return WebAssembly.Module.imports(module).some(i => i.module === "wasi" && i.name === "thread-spawn");
+}
+
+export function sim_memory(module: WebAssembly.Module) {
+    return is_threaded(module) ? new WebAssembly.Memory({ ...THREADS_MEMORY, shared: true }) : new WebAssembly.Memory({ initial: 4 });
+}
+
+// anything not listed is a no-op returning 0, which wasi reads as success
+function stubbed(functions: { [name: string]: any; }) {
+    return new Proxy(functions, {
+        get: (target, name: string) => name in target ? target[name] : () => 0
+    });
+}
+
+// next_tid is only needed for threaded modules
+export function sim_imports(module: WebAssembly.Module, memory: WebAssembly.Memory, next_tid?: Int32Array): WebAssembly.Imports {
+    const imports: WebAssembly.Imports = {
+        env: stubbed({
+            memory,
+            browser_log: (ptr: number) => console.log(cstr_by_ptr(memory.buffer, ptr)),
+        }),
+        // wasi-sdk adds this import namespace when compiling to wasm32-wasi which is default unless --target=wasm32
+        wasi_snapshot_preview1: stubbed({
+            random_get: Math.random
+        }),
+    };
+
+    if (next_tid) {
+        imports.wasi = {
+            // a worker per pthread_create, it runs the new thread's start routine and closes when it returns
+            // the id goes back to pthread_create straight away, the worker starts up on its own
+            "thread-spawn": (start_arg: number) => {
+                const tid = Atomics.add(next_tid, 0, 1);
+                const start: SimThreadStart = { module, memory, tid, start_arg, next_tid };
+                const worker = new Worker(new URL("./sim_thread.mjs", import.meta.url), { type: "module" });
+                worker.postMessage(start);
+                return tid;
+            }
+        };
+    }
+
+    return imports;
+}
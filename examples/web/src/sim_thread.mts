@@ -0,0 +1,16 @@
+// one pthread of a threaded sim module, spawned through the thread-spawn import in sim_imports.mts
+// instantiates the module again over the same shared memory and runs wasi_thread_start, which sets up the
+// thread's stack and tls and calls the start routine pthread_create was given
+
+import { sim_imports, type SimThreadStart } from "./sim_imports.mjs";
+
+self.onmessage = (evt: MessageEvent<SimThreadStart>) => {
+    const { module, memory, tid, start_arg, next_tid } = evt.data;
+    try {
+        const instance = new WebAssembly.Instance(module, sim_imports(module, memory, next_tid));
+        (instance.exports.wasi_thread_start as (tid: number, start_arg: number) => void)(tid, start_arg);
+    } catch (err) {
+        console.error(`sim thread ${tid}:`, err);
+    }
+    self.close();
+};
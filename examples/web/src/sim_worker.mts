@@ -0,0 +1,123 @@
+// runs a sim's wasm module off the main thread, see SimWorkerHost in sim_host.mts for the other end
+// physics steps at a fixed rate whatever the main thread is doing, after each batch of steps the frame is
+// drawn into the module's render buffer and copied into the FrameExchange
+
+import { FrameExchange, RENDER_VERTEX_WORDS } from "./frame_exchange.mjs";
+import { is_threaded, sim_imports, sim_memory } from "./sim_imports.mjs";
+import { type RenderBufferExports } from "./util.mjs";
+
+export type SimWorkerMessage =
+    // module is compiled on the main thread, exchange is FrameExchange.buffer
+    | { type: "init"; module: WebAssembly.Module; exchange: SharedArrayBuffer; step_ms: number; sim_speed: number; }
+    // calls an export with the instance's memory in a consistent state, between steps
+    | { type: "call"; name: string; args: number[]; }
+    | { type: "run"; running: boolean; };
+
+export type SimWorkerReply =
+    | { type: "ready"; }
+    | { type: "error"; message: string; };
+
+interface SimExports extends RenderBufferExports {
+    update_particles: (duration: number) => void;
+    draw_particles: () => void;
+    [name: string]: any;
+}
+
+// steps run at most this many at a time to catch up, past that the time is dropped rather than spiralling
+const MAX_CATCH_UP_STEPS = 4;
+
+let exports: SimExports | null = null;
+let memory: WebAssembly.Memory | null = null;
+let exchange: FrameExchange | null = null;
+let ready: Promise<void> = Promise.resolve();
+
+let step_ms = 1000 / 60;
+let sim_speed = 0.01;
+let running = false;
+let next_step = 0;
+let timer: ReturnType<typeof setTimeout> | null = null;
+
+function reply(message: SimWorkerReply) {
+    self.postMessage(message);
+}
+
+async function init(module: WebAssembly.Module) {
+    // this worker is a threaded module's main thread, its pthreads each get a sim_thread worker over the same memory
+    memory = sim_memory(module);
+    const next_tid = is_threaded(module) ? new Int32Array(new SharedArrayBuffer(4)).fill(1) : undefined;
+    const instance = await WebAssembly.instantiate(module, sim_imports(module, memory, next_tid));
+    exports = instance.exports as SimExports;
+    // the wasi reactor entry, runs constructors and in threaded builds sets up the main thread
+    if (typeof exports._initialize === "function")
+        exports._initialize();
+}
+
+function publish() {
+    if (!exports || !memory || !exchange)
+        return;
+
+    exports.draw_particles();
+    exchange.publish(
+        new Uint32Array(memory.buffer, exports.render_points(), exports.render_point_count() * RENDER_VERTEX_WORDS),
+        new Uint32Array(memory.buffer, exports.render_lines(), exports.render_line_count() * 2 * RENDER_VERTEX_WORDS));
+}
+
+function tick() {
+    timer = null;
+    if (!running || !exports || !exchange)
+        return;
+
+    const now = performance.now();
+    let steps = 0;
+    for (; next_step <= now && steps < MAX_CATCH_UP_STEPS; steps++) {
+        exports.update_particles(step_ms * sim_speed);
+        next_step += step_ms;
+    }
+    if (next_step <= now)
+        next_step = now + step_ms;
+
+    if (steps > 0) {
+        exchange.add_steps(steps);
+        publish();
+    }
+
+    // a timeout rather than a blocking loop so calls and run messages get in between steps
+    timer = setTimeout(tick, Math.max(0, next_step - performance.now()));
+}
+
+function set_running(value: boolean) {
+    running = value;
+    if (timer !== null) {
+        clearTimeout(timer);
+        timer = null;
+    }
+    if (running) {
+        next_step = performance.now();
+        tick();
+    }
+}
+
+self.onmessage = (evt: MessageEvent<SimWorkerMessage>) => {
+    const message = evt.data;
+    // everything waits on init so messages posted straight after it keep their order
+    ready = ready.then(() => {
+        switch (message.type) {
+            case "init":
+                exchange = new FrameExchange(message.exchange);
+                step_ms = message.step_ms;
+                sim_speed = message.sim_speed;
+                return init(message.module).then(() => reply({ type: "ready" }));
+            case "call":
+                if (!exports || typeof exports[message.name] !== "function")
+                    throw new Error(`sim has no export ${message.name}`);
+                exports[message.name](...message.args);
+                // shows the change while the sim is stopped
+                if (!running)
+                    publish();
+                break;
+            case "run":
+                set_running(message.running);
+                break;
+        }
+    }).catch(err => reply({ type: "error", message: String(err) }));
+};
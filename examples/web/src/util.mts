@@ -1,3 +1,5 @@
+import { RENDER_VERTEX_WORDS, type RenderFrame } from "./frame_exchange.mjs";
+
 export function cstrlen(buff: Uint8Array, ptr: number) {
     let len = 0;
     while (buff[ptr] !== 0) {
@@ -10,6 +12,134 @@ export function cstrlen(buff: Uint8Array, ptr: number) {
 export function cstr_by_ptr(buff: ArrayBuffer, ptr: number) {
     const mem = new Uint8Array(buff);
     const len = cstrlen(mem, ptr);
-    const bytes = new Uint8Array(buff, ptr, len);
+    // TextDecoder wont read shared memory, threaded builds log through a copy
+    const bytes = new Uint8Array(buff, ptr, len).slice();
     return new TextDecoder().decode(bytes);
 }
+
+// exports every sim gets from web.h for handing js its frame's points and lines
+export interface RenderBufferExports {
+    render_points: () => number;
+    render_point_count: () => number;
+    render_lines: () => number;
+    render_line_count: () => number;
+}
+
+function rgba_style(rgba: number) {
+    return `rgba(${rgba & 255}, ${(rgba >>> 8) & 255}, ${(rgba >>> 16) & 255}, ${(rgba >>> 24) / 255})`;
+}
+
+// clears ctx and draws the frame a draw_particles call left in the render buffer
+export function draw_render_buffer(ctx: CanvasRenderingContext2D, memory: WebAssembly.Memory, exports: RenderBufferExports) {
+    // views are made every frame, growing memory detaches the old ones
+    const point_count = exports.render_point_count();
+    const line_count = exports.render_line_count();
+    draw_render_frame(ctx, {
+        frame: 0,
+        step: 0,
+        point_count,
+        line_count,
+        point_floats: new Float32Array(memory.buffer, exports.render_points(), point_count * RENDER_VERTEX_WORDS),
+        point_words: new Uint32Array(memory.buffer, exports.render_points(), point_count * RENDER_VERTEX_WORDS),
+        line_floats: new Float32Array(memory.buffer, exports.render_lines(), line_count * 2 * RENDER_VERTEX_WORDS),
+        line_words: new Uint32Array(memory.buffer, exports.render_lines(), line_count * 2 * RENDER_VERTEX_WORDS),
+    });
+}
+
+// clears ctx and draws a frame, out of wasm memory or a FrameExchange slot
+// primitives in a row with the same colour and size go into one path so a frame is a few fills instead of one per particle
+export function draw_render_frame(ctx: CanvasRenderingContext2D, frame: RenderFrame) {
+    ctx.clearRect(0, 0, ctx.canvas.width, ctx.canvas.height);
+
+    const { line_count, line_floats: floats, line_words: words } = frame;
+    let i = 0;
+    while (i < line_count * 2) {
+        const rgba = words[i * RENDER_VERTEX_WORDS + 3];
+        const width = floats[i * RENDER_VERTEX_WORDS + 2];
+        ctx.beginPath();
+        for (; i < line_count * 2 && words[i * RENDER_VERTEX_WORDS + 3] === rgba && floats[i * RENDER_VERTEX_WORDS + 2] === width; i += 2) {
+            ctx.moveTo(floats[i * RENDER_VERTEX_WORDS], floats[i * RENDER_VERTEX_WORDS + 1]);
+            ctx.lineTo(floats[(i + 1) * RENDER_VERTEX_WORDS], floats[(i + 1) * RENDER_VERTEX_WORDS + 1]);
+        }
+        ctx.lineWidth = width;
+        ctx.strokeStyle = rgba_style(rgba);
+        ctx.stroke();
+    }
+
+    const { point_count, point_floats, point_words } = frame;
+    i = 0;
+    while (i < point_count) {
+        const rgba = point_words[i * RENDER_VERTEX_WORDS + 3];
+        ctx.beginPath();
+        for (; i < point_count && point_words[i * RENDER_VERTEX_WORDS + 3] === rgba; i++) {
+            const x = point_floats[i * RENDER_VERTEX_WORDS], y = point_floats[i * RENDER_VERTEX_WORDS + 1], size = point_floats[i * RENDER_VERTEX_WORDS + 2];
+            // a moveTo per arc so the circles dont get joined by lines
+            ctx.moveTo(x + size, y);
+            ctx.arc(x, y, size, 0, 2 * Math.PI);
+        }
+        ctx.fillStyle = rgba_style(rgba);
+        ctx.fill();
+    }
+}
+
+// ParticleStoreLayout in pstore.h as u32 words on wasm32
+const LAYOUT_VERSION = 1;
+const LAYOUT_WORDS = 11;
+const LayoutWord = {
+    VERSION: 0, PRECISION: 1, GENERATION: 2, COUNT: 3,
+    POSITION_X: 4, POSITION_Y: 5, POSITION_Z: 6,
+    VELOCITY_X: 7, VELOCITY_Y: 8, VELOCITY_Z: 9,
+    HANDLES: 10
+} as const;
+
+// typed array views straight over a ParticleStore's arrays in wasm memory, reading them costs no calls
+// refresh once per frame before reading, views are only rebuilt when the store's generation changes or memory grows
+export class ParticleStateView {
+    position_x = new Float32Array(0);
+    position_y = new Float32Array(0);
+    position_z = new Float32Array(0);
+    velocity_x = new Float32Array(0);
+    velocity_y = new Float32Array(0);
+    velocity_z = new Float32Array(0);
+    // slot -> handle, slots can be reordered between frames
+    handles = new Uint32Array(0);
+    count = 0;
+
+    private memory: WebAssembly.Memory;
+    private layout_ptr: number;
+    private generation = -1;
+    private buffer: ArrayBuffer | null = null;
+
+    // layout_ptr is what the module's particle_state export returns
+    constructor(memory: WebAssembly.Memory, layout_ptr: number) {
+        this.memory = memory;
+        this.layout_ptr = layout_ptr;
+        const header = new Uint32Array(memory.buffer, layout_ptr, LAYOUT_WORDS);
+        if (header[LayoutWord.VERSION] !== LAYOUT_VERSION)
+            throw new Error(`particle state layout ${header[LayoutWord.VERSION]}, expected ${LAYOUT_VERSION}`);
+        // only float builds can be wrapped in a Float32Array
+        if (header[LayoutWord.PRECISION] !== 0)
+            throw new Error(`particle state precision ${header[LayoutWord.PRECISION]} isnt float`);
+    }
+
+    // returns true when the views were rebuilt
+    refresh() {
+        const header = new Uint32Array(this.memory.buffer, this.layout_ptr, LAYOUT_WORDS);
+        if (this.buffer === this.memory.buffer && this.generation === header[LayoutWord.GENERATION])
+            return false;
+
+        const buffer = this.memory.buffer;
+        const count = header[LayoutWord.COUNT];
+        this.position_x = new Float32Array(buffer, header[LayoutWord.POSITION_X], count);
+        this.position_y = new Float32Array(buffer, header[LayoutWord.POSITION_Y], count);
+        this.position_z = new Float32Array(buffer, header[LayoutWord.POSITION_Z], count);
+        this.velocity_x = new Float32Array(buffer, header[LayoutWord.VELOCITY_X], count);
+        this.velocity_y = new Float32Array(buffer, header[LayoutWord.VELOCITY_Y], count);
+        this.velocity_z = new Float32Array(buffer, header[LayoutWord.VELOCITY_Z], count);
+        this.handles = new Uint32Array(buffer, header[LayoutWord.HANDLES], count);
+        this.count = count;
+        this.generation = header[LayoutWord.GENERATION];
+        this.buffer = buffer;
+        return true;
+    }
+}
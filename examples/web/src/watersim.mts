@@ -1,6 +1,8 @@
 import { Compass, scale_to_len } from "./components/compass_input.mjs";
-import { ElementLoaderCallback } from "./loader.mjs";
-import { cstr_by_ptr } from "./util.mjs";
+import { compile_wasm, ElementLoaderCallback } from "./loader.mjs";
+import { SimWorkerHost } from "./sim_host.mjs";
+import { is_threaded } from "./sim_imports.mjs";
+import { cstr_by_ptr, draw_render_buffer, draw_render_frame, ParticleStateView, RenderBufferExports } from "./util.mjs";
 
 export const load = async (load_elems: ElementLoaderCallback, update_timer: (n: number) => void, reset_timer: () => void) => {
     const game_canvas = document.createElement("canvas");
@@ -17,16 +19,15 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     let DAMPING = 0.95;
     let PARTICLE_RADIUS = 5;
     let GRAVITY_SCALE = 9.81;
+    // the particle count main in watersim.cpp makes
+    const NUM_PARTICLES = 4000;
 
     const memory = new WebAssembly.Memory({ initial: 4 });
     const import_object = {
         env: {
             memory,
-            browser_draw_point,
             browser_log,
-            browser_clear_canvas,
             browser_draw_rect: (...args: any[]) => { },
-            browser_draw_line,
             browser_draw_radial_gradient
         },
         // wasi-sdk adds this import namespace when compiling to wasm32-wasi which is default unless --target=wasm32
@@ -45,7 +46,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     };
 
     interface WasmInstance extends WebAssembly.Instance {
-        exports: {
+        exports: RenderBufferExports & {
             spawn_particle: (x: number, y: number) => void;
             update_particles: (delta_time: number) => void;
             draw_particles: () => void;
@@ -55,20 +56,73 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
             set_gravity: (x: number, y: number) => void;
             set_damping: (damping: number) => void;
             set_particle_radius: (radius: number) => void;
+            set_thread_count: (threads: number) => void;
+            particle_state: () => number;
         };
     }
-    const wasm = (await WebAssembly.instantiateStreaming(fetch("out/watersim.wasm"), import_object)).instance as WasmInstance;
-    wasm.exports.main();
+    type SimCall = "main" | "set_gravity" | "set_damping" | "set_particle_radius" | "set_thread_count";
+    // physics runs in a worker when the page can share memory with one, otherwise on the main thread in the frame loop
+    // a worker can run the threaded build from make build-threads, which splits the fluid passes over more workers
+    const worker_mode = SimWorkerHost.supported();
+    const module = await compile_wasm("watersim", worker_mode);
+    const host = worker_mode ? new SimWorkerHost(SimWorkerHost.create_worker(), module, { point_capacity: NUM_PARTICLES }) : null;
+    const wasm = host ? null : (await WebAssembly.instantiate(module, import_object)) as WasmInstance;
 
-    function browser_draw_point(x: number, y: number, size: number, r: number, g: number, b: number) {
-        if (!ctx) return;
+    function call(name: SimCall, ...args: number[]) {
+        if (host)
+            host.call(name, ...args);
+        else
+            (wasm!.exports[name] as (...args: number[]) => unknown)(...args);
+    }
 
-        ctx.beginPath();
-        ctx.arc(x, y, size, 0, 2 * Math.PI);
-        ctx.fillStyle = `rgb(${r}, ${g}, ${b})`;
-        ctx.fill();
-        ctx.closePath();
-    };
+    let last_frame = 0;
+    function draw() {
+        if (host) {
+            const frame = host.acquire(last_frame);
+            if (!frame)
+                return;
+            draw_render_frame(ctx!, frame);
+            last_frame = frame.frame;
+            host.release();
+        } else {
+            wasm!.exports.draw_particles();
+            draw_render_buffer(ctx!, memory, wasm!.exports);
+        }
+    }
+
+    call("main");
+    // past 8 the fluid passes dont have enough particles per thread to pay for it
+    const threads = host && is_threaded(module) ? Math.min(navigator.hardwareConcurrency || 1, 8) : 1;
+    if (threads > 1)
+        call("set_thread_count", threads);
+
+    const stats_label = document.createTextNode("");
+    let stats_time = performance.now();
+    let stats_steps = 0;
+    function update_host_stats() {
+        const now = performance.now();
+        if (now - stats_time < 1000)
+            return;
+        const steps = host!.exchange.steps;
+        stats_label.textContent = `physics ${((steps - stats_steps) * 1000 / (now - stats_time)).toFixed(0)} steps/s on ${threads} threads, ${host!.exchange.dropped} frames dropped`;
+        stats_time = now;
+        stats_steps = steps;
+    }
+
+    // the overlay reads particle state in place, no call per particle
+    const state = host ? null : new ParticleStateView(memory, wasm!.exports.particle_state());
+    function update_stats() {
+        if (!state)
+            return update_host_stats();
+        state.refresh();
+        let speed = 0, height = 0;
+        for (let i = 0; i < state.count; i++) {
+            speed += Math.hypot(state.velocity_x[i], state.velocity_y[i]);
+            height += state.position_y[i];
+        }
+        const count = Math.max(state.count, 1);
+        stats_label.textContent = `mean speed ${(speed / count).toFixed(1)}, mean height ${(height / count).toFixed(0)}`;
+    }
 
     function browser_draw_radial_gradient(
         x: number, y: number,
@@ -88,41 +142,32 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         ctx.closePath();
     }
 
-    function browser_draw_line(x1: number, y1: number, x2: number, y2: number, r: number, g: number, b: number) {
-        if (!ctx) return;
-
-        ctx.beginPath();
-        ctx.moveTo(x1, y1);
-        ctx.lineTo(x2, y2);
-        ctx.strokeStyle = `rgb(${r}, ${g}, ${b})`;
-        ctx.stroke();
-        ctx.closePath();
-    }
-
     function browser_log(log_ptr: number) {
         const buffer = memory.buffer;
         const message = cstr_by_ptr(buffer, log_ptr);
         console.log(message);
     }
 
-    function browser_clear_canvas() {
-        if (!ctx) return;
-
-        ctx.clearRect(0, 0, game_canvas.width, game_canvas.height);
-    }
-
     let prev_timestamp: number | null = null;
     let started = false;
     let frame_ids: number[] = [];
     function loop(timestamp: number) {
         if (!started) {
             prev_timestamp = null;
+            // a stopped worker still publishes after main and after calls, so keep drawing what it sends
+            if (host) {
+                draw();
+                frame_ids.push(window.requestAnimationFrame(loop));
+            }
             return;
         };
 
         if (prev_timestamp !== null) {
-            wasm.exports.update_particles((timestamp - prev_timestamp) * SIM_SPEED);
-            wasm.exports.draw_particles();
+            // the worker steps on its own clock
+            if (!host)
+                wasm!.exports.update_particles((timestamp - prev_timestamp) * SIM_SPEED);
+            draw();
+            update_stats();
             if (Math.floor(((timestamp - prev_timestamp) / 1000) % 60) === 0)
                 update_timer(timestamp - prev_timestamp);
         }
@@ -137,6 +182,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
                 evt.preventDefault();
                 frame_ids.forEach(id => window.cancelAnimationFrame(id));
                 started = !started;
+                host?.run(started);
                 frame_ids.push(window.requestAnimationFrame(loop));
                 break;
         }
@@ -154,6 +200,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         evt.preventDefault();
         frame_ids.forEach(id => window.cancelAnimationFrame(id));
         started = !started;
+        host?.run(started);
         frame_ids.push(window.requestAnimationFrame(loop));
     };
     container.appendChild(start_button);
@@ -169,7 +216,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     damping_slider.onchange = evt => {
         // @ts-ignore
         DAMPING = evt.target.value;;
-        wasm.exports.set_damping(DAMPING);
+        call("set_damping", DAMPING);
 
         damping_slider_label.textContent = `damping ${DAMPING}`;
     };
@@ -184,7 +231,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
     particle_radius.onchange = evt => {
         // @ts-ignore
         PARTICLE_RADIUS = evt.target.value;
-        wasm.exports.set_particle_radius(PARTICLE_RADIUS);
+        call("set_particle_radius", PARTICLE_RADIUS);
     };
     const radius_label = document.createTextNode(`particle radius`);
     container.appendChild(radius_label);
@@ -206,10 +253,19 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
 
     function gravity_dir_handler(dir: { x: number, y: number; }) {
         const gravity = scale_to_len(dir, GRAVITY_SCALE);
-        wasm.exports.set_gravity(gravity.x, gravity.y);
+        call("set_gravity", gravity.x, gravity.y);
     };
     container.appendChild(Compass(gravity_dir_handler));
 
+    update_stats();
+    container.appendChild(stats_label);
+
+    // the starting block, shown before the sim is started
+    if (host)
+        frame_ids.push(window.requestAnimationFrame(loop));
+    else
+        draw();
+
     load_elems([game_canvas, container]);
 
     return () => {
@@ -217,6 +273,7 @@ export const load = async (load_elems: ElementLoaderCallback, update_timer: (n:
         frame_ids = [];
         prev_timestamp = null;
         started = false;
+        host?.terminate();
         reset_timer();
     };
 };
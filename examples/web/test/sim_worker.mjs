@@ -0,0 +1,173 @@
+// @ts-check
+// headless check of the worker hosted sims, runs on the tsc output in out/ so build first (npm test does)
+//     node test/sim_worker.mjs [paths of sim wasm, every build of out/watersim by default]
+// first hammers a FrameExchange from a second thread and checks no frame the main thread reads is torn,
+// then runs each sim in sim_worker.mjs on a worker thread and checks it keeps stepping while the main thread is busy,
+// threaded builds get their pthreads as more worker threads through the same thread-spawn import the browser uses
+
+import { Worker } from "node:worker_threads";
+import { readFileSync, existsSync } from "node:fs";
+import { fileURLToPath } from "node:url";
+
+const OUT = new URL("../out/", import.meta.url);
+const { FrameExchange, RENDER_VERTEX_WORDS } = await import(new URL("frame_exchange.mjs", OUT).href);
+const { SimWorkerHost } = await import(new URL("sim_host.mjs", OUT).href);
+const { is_threaded } = await import(new URL("sim_imports.mjs", OUT).href);
+
+let failures = 0;
+function check(ok, message) {
+    console.log(`${ok ? "ok  " : "FAIL"} ${message}`);
+    if (!ok)
+        failures++;
+}
+
+const sleep = (/** @type {number} */ ms) => new Promise(resolve => setTimeout(resolve, ms));
+
+// spins the main thread like a long frame would
+function busy(/** @type {number} */ ms) {
+    const end = performance.now() + ms;
+    while (performance.now() < end);
+}
+
+// writer publishes frames of varying size with every word set to the attempt number, so a torn read shows up
+// as a frame whose words disagree
+async function exchange_stress(ms) {
+    const exchange = FrameExchange.create(256, 64);
+    const writer = new Worker(`
+        const { workerData } = require("node:worker_threads");
+        import(workerData.url).then(({ FrameExchange }) => {
+            const exchange = new FrameExchange(workerData.buffer);
+            const points = new Uint32Array(exchange.point_capacity * ${RENDER_VERTEX_WORDS});
+            const lines = new Uint32Array(exchange.line_capacity * 2 * ${RENDER_VERTEX_WORDS});
+            const end = Date.now() + workerData.ms;
+            for (let n = 1; Date.now() < end; n++) {
+                const point_count = 1 + n % exchange.point_capacity, line_count = n % exchange.line_capacity;
+                points.fill(n, 0, point_count * ${RENDER_VERTEX_WORDS});
+                lines.fill(n, 0, line_count * 2 * ${RENDER_VERTEX_WORDS});
+                exchange.add_steps(1);
+                exchange.publish(points.subarray(0, point_count * ${RENDER_VERTEX_WORDS}), lines.subarray(0, line_count * 2 * ${RENDER_VERTEX_WORDS}));
+            }
+        });`, { eval: true, workerData: { url: new URL("frame_exchange.mjs", OUT).href, buffer: exchange.buffer, ms } });
+    const done = new Promise(resolve => writer.on("exit", resolve));
+
+    let reads = 0, torn = 0, backwards = 0, last_frame = 0;
+    const end = performance.now() + ms;
+    while (performance.now() < end) {
+        const frame = exchange.acquire();
+        if (!frame)
+            continue;
+        const n = frame.point_words[0];
+        for (let i = 0; i < frame.point_count * RENDER_VERTEX_WORDS; i++)
+            if (frame.point_words[i] !== n) { torn++; break; }
+        for (let i = 0; i < frame.line_count * 2 * RENDER_VERTEX_WORDS; i++)
+            if (frame.line_words[i] !== n) { torn++; break; }
+        if (frame.frame < last_frame)
+            backwards++;
+        last_frame = frame.frame;
+        reads++;
+        exchange.release();
+    }
+    await done;
+
+    check(reads > 0 && last_frame > 0, `exchange: ${reads} reads of ${last_frame} frames, ${exchange.dropped} publishes dropped`);
+    check(torn === 0, `exchange: ${torn} torn frames`);
+    check(backwards === 0, `exchange: ${backwards} frames older than the one before`);
+}
+
+// runs in every worker_threads Worker to make it look like a browser one to sim_worker.mjs and sim_thread.mjs,
+// including a Worker of its own for the workers they start
+const BROWSER_WORKER_SHIM = `
+    // no top level Worker binding here, it would shadow the global one from the modules too
+    const { parentPort, workerData } = require("node:worker_threads");
+    globalThis.self = globalThis;
+    self.postMessage = message => parentPort.postMessage(message);
+    self.close = () => process.exit();
+    globalThis.Worker = class {
+        constructor(url) {
+            this.onmessage = null;
+            this.worker = new (require("node:worker_threads").Worker)(workerData.shim, { eval: true, workerData: { shim: workerData.shim, url: String(url) } });
+            this.worker.on("message", data => this.onmessage?.({ data }));
+        }
+        postMessage(message) { this.worker.postMessage(message); }
+        terminate() { this.worker.terminate(); }
+    };
+    // the port holds messages until it has a listener, so nothing posted during the import is lost
+    import(workerData.url).then(() => parentPort.on("message", data => self.onmessage({ data })));`;
+
+function browser_worker(/** @type {URL} */ url) {
+    const worker = new Worker(BROWSER_WORKER_SHIM, { eval: true, workerData: { shim: BROWSER_WORKER_SHIM, url: url.href } });
+    /** @type {{ postMessage: (message: any) => void, onmessage: ((evt: any) => any) | null, terminate: () => void }} */
+    const like = {
+        postMessage: message => worker.postMessage(message),
+        onmessage: null,
+        terminate: () => { worker.terminate(); }
+    };
+    worker.on("message", data => like.onmessage?.({ data }));
+    worker.on("error", err => check(false, `sim worker threw ${err}`));
+    return like;
+}
+
+async function sim(/** @type {string} */ wasm_path) {
+    if (!existsSync(wasm_path)) {
+        console.log(`skip sim: no ${wasm_path}, build it with make`);
+        return;
+    }
+    const module = new WebAssembly.Module(readFileSync(wasm_path));
+    const names = WebAssembly.Module.exports(module).map(e => e.name);
+    if (!["update_particles", "draw_particles", "render_points"].every(name => names.includes(name))) {
+        console.log(`skip sim: ${wasm_path} predates the render buffer, rebuild it with make`);
+        return;
+    }
+
+    const step_ms = 1000 / 60;
+    const host = new SimWorkerHost(browser_worker(new URL("sim_worker.mjs", OUT)), module, { point_capacity: 1 << 16, line_capacity: 1 << 12, step_ms });
+    if (names.includes("main"))
+        host.call("main");
+    const threads = is_threaded(module) && names.includes("set_thread_count") ? 4 : 1;
+    if (threads > 1)
+        host.call("set_thread_count", threads);
+    await host.wait_ready();
+
+    host.run(true);
+    await sleep(500);
+
+    // the main thread stalls for a few frames, the worker should keep its rate through it
+    const steps_before = host.exchange.steps;
+    const stall_ms = 500;
+    busy(stall_ms);
+    const stalled_steps = host.exchange.steps - steps_before;
+
+    let frames = 0, last_frame = 0, bad_points = 0, point_count = 0;
+    const start = performance.now(), start_steps = host.exchange.steps;
+    while (performance.now() - start < 1000) {
+        const frame = host.acquire(last_frame);
+        if (frame) {
+            frames++;
+            last_frame = frame.frame;
+            point_count = frame.point_count;
+            for (let i = 0; i < frame.point_count * RENDER_VERTEX_WORDS; i += RENDER_VERTEX_WORDS)
+                if (!Number.isFinite(frame.point_floats[i]) || !Number.isFinite(frame.point_floats[i + 1]))
+                    bad_points++;
+            host.release();
+        }
+        await sleep(step_ms);
+    }
+    const rate = (host.exchange.steps - start_steps) * 1000 / (performance.now() - start);
+    host.run(false);
+    host.terminate();
+
+    check(frames > 0 && point_count > 0, `sim ${wasm_path} on ${threads} threads: drew ${frames} frames of ${point_count} points`);
+    check(bad_points === 0, `sim: ${bad_points} points that arent finite`);
+    check(stalled_steps > 0, `sim: ${stalled_steps} steps during a ${stall_ms}ms main thread stall`);
+    console.log(`     ${rate.toFixed(1)} steps/s against a target of ${(1000 / step_ms).toFixed(0)}, ${host.exchange.dropped} publishes dropped`);
+}
+
+await exchange_stress(1000);
+const wasm_paths = process.argv.length > 2 ? process.argv.slice(2) : ["watersim.wasm", "watersim-simd.wasm", "watersim-threads.wasm", "watersim-threads-simd.wasm"].map(name => fileURLToPath(new URL(name, OUT)));
+for (const wasm_path of wasm_paths)
+    await sim(wasm_path);
+
+if (failures > 0)
+    console.log(`${failures} failed`);
+// a threaded sim's pthread workers are parked on the pool, dont wait for them
+process.exit(failures > 0 ? 1 : 0);
@@ -2,10 +2,11 @@
 #define GABBYPHYSICS_CORE_H
 
 #include "precision.h"
-#include "random"
 
 namespace gabbyphysics
 {
+    class Random;
+
     class Vector3
     {
     public:
@@ -13,10 +14,12 @@ namespace gabbyphysics
         real y;
         real z;
 
+#if GABBYPHYSICS_VECTOR3_REALS == 4
     private:
         real pad;
 
     public:
+#endif
         Vector3() : x(0), y(0), z(0) {}
 
         Vector3(const real x, const real y, const real z) : x(x), y(y), z(z) {}
@@ -30,15 +33,10 @@ namespace gabbyphysics
         const static Vector3 Y;
         const static Vector3 Z;
 
-        static Vector3 get_random()
-        {
-            std::mt19937_64 gen{std::random_device()()};
-            std::uniform_real_distribution<double> dis{0.0, 1.0};
-
-            Vector3 vec = Vector3(dis(gen), dis(gen), dis(gen));
-            vec.normalize();
-            return vec;
-        }
+        // components in [0, 1) normalized, from a generator per thread seeded once from std::random_device
+        static Vector3 get_random();
+        // the same from a seeded generator, so runs can be replayed
+        static Vector3 get_random(Random &random);
 
         void operator+=(const Vector3 &v)
         {
@@ -164,6 +162,34 @@ namespace gabbyphysics
             x = y = z = 0;
         }
     };
+
+    static_assert(sizeof(Vector3) == GABBYPHYSICS_VECTOR3_REALS * sizeof(real), "Vector3 layout doesnt match precision.h");
+
+    // xoshiro256** seeded through splitmix64, 32 bytes of state against mt19937_64's 5 KB
+    // every real it hands out comes from integer math so fixed point builds stay deterministic
+    class Random
+    {
+        unsigned long long state[4];
+
+    public:
+        Random(unsigned long long seed = 0);
+
+        void seed(unsigned long long seed);
+        unsigned long long next();
+        // skips 2^128 draws, streams seeded the same then jumped 0, 1, 2... times never overlap
+        void jump();
+
+        // [0, 1)
+        real unit();
+        // [min, max)
+        real range(real min, real max);
+        // uniform over the sphere
+        Vector3 unit_vector();
+        // count vectors the unit_vector way, drawn and normalized a block at a time
+        // the candidates are the ones unit_vector would draw but the simd math can round differently, and the
+        // generator ends up to a block further along than count unit_vector calls would leave it
+        void unit_vectors(Vector3 *out, unsigned count);
+    };
 }
 
 #endif // !GABBYPHYSICS_CORE_H
@@ -0,0 +1,79 @@
+#ifndef GABBYPHYSICS_FIXED_H
+#define GABBYPHYSICS_FIXED_H
+
+#include "climits"
+#include "type_traits"
+
+namespace gabbyphysics
+{
+    // signed 32.32 fixed point, the real of GABBYPHYSICS_FIXED_POINT builds
+    // every operation is integer math so a step gives the same bits on every compiler and platform, for lockstep games
+    // range is about +-2 billion with a resolution of about 2.3e-10, products and quotients go through 128 bit integers
+    class fixed
+    {
+    public:
+        typedef long long raw_type;
+        const static int FRACTION_BITS = 32;
+        constexpr static raw_type ONE = raw_type(1) << FRACTION_BITS;
+
+        raw_type raw;
+
+        constexpr fixed() : raw(0) {}
+
+        // conversions in are implicit so literals like 0.5f and counters like real(i) read the same as in float builds
+        template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        constexpr fixed(T value) : raw(raw_type(value) * ONE) {}
+
+        // truncates toward zero, float to double is exact so a literal always converts to the same bits
+        template <typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+        constexpr fixed(T value) : raw(raw_type(double(value) * double(ONE))) {}
+
+        constexpr static fixed from_raw(raw_type raw)
+        {
+            fixed result;
+            result.raw = raw;
+            return result;
+        }
+
+        // conversions out are explicit so mixed expressions never silently fall back to float math
+        template <typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+        explicit constexpr operator T() const { return T(double(raw) / double(ONE)); }
+
+        // truncates toward zero like a float to int cast
+        template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        explicit constexpr operator T() const { return T(raw / ONE); }
+
+        friend constexpr fixed operator+(fixed a, fixed b) { return from_raw(a.raw + b.raw); }
+        friend constexpr fixed operator-(fixed a, fixed b) { return from_raw(a.raw - b.raw); }
+        friend constexpr fixed operator*(fixed a, fixed b) { return from_raw(raw_type((__int128)a.raw * b.raw >> FRACTION_BITS)); }
+        // dividing by zero saturates instead of trapping, the float builds would give an infinity here
+        friend constexpr fixed operator/(fixed a, fixed b)
+        {
+            if (b.raw == 0)
+                return from_raw(a.raw < 0 ? -LLONG_MAX : LLONG_MAX);
+            return from_raw(raw_type((__int128)a.raw * ONE / b.raw));
+        }
+        constexpr fixed operator-() const { return from_raw(-raw); }
+
+        fixed &operator+=(fixed o) { return *this = *this + o; }
+        fixed &operator-=(fixed o) { return *this = *this - o; }
+        fixed &operator*=(fixed o) { return *this = *this * o; }
+        fixed &operator/=(fixed o) { return *this = *this / o; }
+
+        friend constexpr bool operator==(fixed a, fixed b) { return a.raw == b.raw; }
+        friend constexpr bool operator!=(fixed a, fixed b) { return a.raw != b.raw; }
+        friend constexpr bool operator<(fixed a, fixed b) { return a.raw < b.raw; }
+        friend constexpr bool operator>(fixed a, fixed b) { return a.raw > b.raw; }
+        friend constexpr bool operator<=(fixed a, fixed b) { return a.raw <= b.raw; }
+        friend constexpr bool operator>=(fixed a, fixed b) { return a.raw >= b.raw; }
+    };
+
+    fixed fixed_sqrt(fixed value);
+    // value must be positive, anything else gives 0
+    fixed fixed_pow(fixed value, fixed exponent);
+    fixed fixed_abs(fixed value);
+    fixed fixed_fmod(fixed value, fixed divisor);
+    fixed fixed_floor(fixed value);
+}
+
+#endif // !GABBYPHYSICS_FIXED_H
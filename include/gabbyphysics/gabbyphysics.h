@@ -1,8 +1,13 @@
 #include "precision.h"
 #include "core.h"
+#include "simd.h"
 #include "particle.h"
+#include "pstore.h"
 #include "helper.h"
 #include "pcontacts.h"
 #include "pfgen.h"
+#include "pjobs.h"
 #include "plinks.h"
 #include "pworld.h"
+#include "pbroadphase.h"
+#include "psph.h"
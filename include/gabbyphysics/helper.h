@@ -1,7 +1,10 @@
 #ifndef GABBYPHYSICS_HELPER_H
 #define GABBYPHYSICS_HELPER_H
 
+#include "cstdio"
+#include "memory"
 #include "string"
+#include "vector"
 
 namespace gabbyphysics
 {
@@ -15,6 +18,14 @@ namespace gabbyphysics
         std::snprintf(buf.get(), size, format.c_str(), args...);
         return std::string(buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
     }
+
+    // o(1) unordered removal, the last element takes the removed one's place
+    template <typename T>
+    void swap_and_pop(std::vector<T> &array, unsigned index)
+    {
+        array[index] = array.back();
+        array.pop_back();
+    }
 }
 
 #endif // !GABBYPHYSICS_HELPER_H
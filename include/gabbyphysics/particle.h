@@ -2,26 +2,34 @@
 #define GABBYPHYSICS_PARTICLE_H
 
 #include "core.h"
+#include "pstore.h"
 
 namespace gabbyphysics
 {
+    // a particle is a handle to a slot in a ParticleStore, all of its state lives in the store's arrays
+    // default constructed particles own a slot in the calling thread's ParticleStore::get_standalone() and free it
+    // when destroyed, copying one copies its state into a new slot in the copying thread's standalone store
+    // particles made from a store and handle are views, copying one aliases the same slot and nothing is freed
     class Particle
     {
     protected:
-        Vector3 position;
-        Vector3 velocity;
-        Vector3 acceleration;
-        Vector3 force_accum;
-        /**
-         * [0, 1]: 0 means object stops without continuous force, 1 means no change in velocity
-         * 0.995 is good to make an object 'look' like its not experiencing drag
-         */
-        real damping;
-        // inverse_mass=0 implies infinite mass i.e. unmovable
-        real inverse_mass;
+        ParticleStore *store;
+        ParticleStore::Handle handle;
+        bool owner;
+
+        void release();
 
     public:
-        Particle() {}
+        Particle();
+        Particle(ParticleStore *store, ParticleStore::Handle handle);
+        Particle(const Particle &other);
+        Particle(Particle &&other) noexcept;
+        Particle &operator=(const Particle &other);
+        Particle &operator=(Particle &&other) noexcept;
+        ~Particle();
+
+        ParticleStore *get_store() const { return store; }
+        ParticleStore::Handle get_handle() const { return handle; }
         void set_position(const Vector3 &position);
         void set_position(const real x, const real y, const real z);
         Vector3 get_position() const;
@@ -32,12 +40,20 @@ namespace gabbyphysics
         void get_velocity(Vector3 *vec) const;
         void set_acceleration(const Vector3 &acceleration);
         Vector3 get_acceleration() const;
+        /**
+         * [0, 1]: 0 means object stops without continuous force, 1 means no change in velocity
+         * 0.995 is good to make an object 'look' like its not experiencing drag
+         */
         void set_damping(const real damping);
         real get_damping() const;
         void set_mass(const real mass);
         real get_mass() const;
+        // inverse_mass=0 implies infinite mass i.e. unmovable
         void set_inverse_mass(const real inverse_mass);
         real get_inverse_mass() const;
+        // bit mask of the layers the particle is in, force fields only push particles in their mask
+        void set_layers(unsigned layers);
+        unsigned get_layers() const;
         void integrate(real duration);
         void clear_accumulator();
         bool has_finite_mass() const;
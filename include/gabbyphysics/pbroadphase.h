@@ -0,0 +1,300 @@
+#ifndef GABBYPHYSICS_PBROADPHASE_H
+#define GABBYPHYSICS_PBROADPHASE_H
+
+#include "pworld.h"
+
+#include "vector"
+
+namespace gabbyphysics
+{
+    // uniform grid hashed into a table and rebuilt from scratch with a counting sort
+    // cells are cell_size wide, so with cell_size >= the largest interaction distance
+    // everything near a point is in the 27 cells around it
+    class ParticleSpatialHash
+    {
+    protected:
+        real cell_size;
+        real inverse_cell_size;
+        unsigned table_mask;
+        // bucket b holds entries [bucket_start[b], bucket_start[b + 1])
+        std::vector<unsigned> bucket_start;
+        // point indices sorted by bucket
+        std::vector<unsigned> entries;
+        std::vector<unsigned> point_buckets;
+
+    public:
+        // cell coordinates are clamped to [-MAX_CELL, MAX_CELL] before converting, so a huge or nan position cant
+        // overflow the int, points further out share the edge cell and nan lands in cell 0
+        const static int MAX_CELL = 1 << 20;
+
+        ParticleSpatialHash(real cell_size = 1);
+
+        void set_cell_size(real cell_size);
+        real get_cell_size() const;
+
+        // rebuilds the table for count points, the table grows to at least twice the point count
+        void build(const real *x, const real *y, const real *z, unsigned count);
+
+        int cell_coord(real value) const;
+        unsigned bucket(int cell_x, int cell_y, int cell_z) const;
+        // buckets of the 27 cells around a point, each listed once even if several cells share a bucket
+        // returns how many of out were written
+        unsigned neighbour_buckets(real x, real y, real z, unsigned out[27]) const;
+
+        // [begin, end) points in a bucket, they can come from any cell that hashes to it
+        const unsigned *begin(unsigned bucket) const { return entries.data() + bucket_start[bucket]; }
+        const unsigned *end(unsigned bucket) const { return entries.data() + bucket_start[bucket + 1]; }
+        // points in bucket order, points in the same cell are next to each other
+        const std::vector<unsigned> &get_entries() const { return entries; }
+    };
+
+    // sweep and prune over the bounding boxes of spheres
+    // endpoints stay sorted between frames on all three axes, each build insertion sorts them again
+    // which is close to linear when points only move a little per frame
+    class ParticleSweepAndPrune
+    {
+    public:
+        struct Pair
+        {
+            // first < second
+            unsigned first;
+            unsigned second;
+        };
+
+    protected:
+        struct Endpoint
+        {
+            real value;
+            // point * 2, plus 1 for the box's max end
+            unsigned id;
+        };
+
+        std::vector<Endpoint> endpoints[3];
+        std::vector<real> box_min[3];
+        std::vector<real> box_max[3];
+        unsigned sweep_axis;
+
+        // boxes open at the current point of the sweep
+        std::vector<unsigned> active;
+        std::vector<unsigned> active_position;
+        std::vector<Pair> pairs;
+
+        void sort_axis(unsigned axis);
+        unsigned choose_axis(const real *x, const real *y, const real *z, unsigned count) const;
+
+    public:
+        ParticleSweepAndPrune();
+
+        // boxes are the spheres at x, y, z with radii, indexed like the points
+        // a change in count starts the endpoints over with a full sort
+        void build(const real *x, const real *y, const real *z, const real *radii, unsigned count);
+
+        // every pair whose boxes overlap, found along the axis the centres spread out most on
+        const std::vector<Pair> &get_pairs() const { return pairs; }
+        unsigned get_sweep_axis() const { return sweep_axis; }
+    };
+
+    struct ParticleAABB
+    {
+        Vector3 min;
+        Vector3 max;
+
+        bool overlaps(const ParticleAABB &other) const;
+        bool contains(const ParticleAABB &other) const;
+        ParticleAABB merge(const ParticleAABB &other) const;
+        real surface_area() const;
+    };
+
+    // dynamic aabb tree over static geometry and moving particles
+    // leaves are kept balanced with rotations as they go in, moving leaves are stored with a fattened
+    // box and only reinserted once their tight box leaves it, static leaves never have to be touched
+    class ParticleAABBTree
+    {
+    public:
+        const static unsigned NONE = 0xffffffffu;
+
+    protected:
+        struct Node
+        {
+            ParticleAABB box;
+            unsigned parent;
+            // both NONE for a leaf
+            unsigned child[2];
+            // leaf data for queries
+            unsigned user;
+            // a leaf's category bits, or every category found under an internal node
+            unsigned categories;
+            unsigned height;
+
+            bool is_leaf() const { return child[0] == NONE; }
+        };
+
+        std::vector<Node> nodes;
+        unsigned root;
+        // free nodes are chained through parent
+        unsigned free_list;
+        std::vector<unsigned> stack;
+
+        unsigned allocate_node();
+        void free_node(unsigned node);
+        void insert_leaf(unsigned leaf);
+        void remove_leaf(unsigned leaf);
+        unsigned balance(unsigned node);
+        void refit(unsigned node);
+
+    public:
+        ParticleAABBTree();
+
+        // returns the proxy id the leaf keeps until it is removed
+        unsigned insert(const ParticleAABB &box, unsigned user, unsigned categories = 1);
+        void remove(unsigned proxy);
+        // stores box grown by margin when box has left the proxy's fat box, returns true if the tree changed
+        bool move(unsigned proxy, const ParticleAABB &box, real margin);
+        void clear();
+
+        const ParticleAABB &get_fat_box(unsigned proxy) const { return nodes[proxy].box; }
+        unsigned get_user(unsigned proxy) const { return nodes[proxy].user; }
+        unsigned get_categories(unsigned proxy) const { return nodes[proxy].categories; }
+        unsigned get_height() const;
+
+        // calls callback(proxy) for every leaf whose box overlaps box and shares a category bit with categories
+        // stops early if callback returns false
+        template <typename Callback>
+        void query(const ParticleAABB &box, unsigned categories, Callback callback);
+    };
+
+    template <typename Callback>
+    void ParticleAABBTree::query(const ParticleAABB &box, unsigned categories, Callback callback)
+    {
+        if (root == NONE)
+            return;
+
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            unsigned n = stack.back();
+            stack.pop_back();
+
+            const Node &node = nodes[n];
+            if (!(node.categories & categories) || !node.box.overlaps(box))
+                continue;
+
+            if (node.is_leaf())
+            {
+                if (!callback(n))
+                    return;
+            }
+            else
+            {
+                stack.push_back(node.child[0]);
+                stack.push_back(node.child[1]);
+            }
+        }
+    }
+
+    // sphere-sphere contacts between particles of a world
+    // every particle uses radius unless per particle radii are given, indexed like the particles
+    // each add_contact or add_contacts gathers the positions again and brings its broadphase up to date before writing
+    // anything, so running one twice in a frame finds the same contacts
+    class ParticleCollisionGenerator : public ParticleContactGenerator
+    {
+    protected:
+        ParticleWorld::Particles *particles;
+        real radius;
+        real restitution;
+        const std::vector<real> *radii;
+
+        // positions gathered once per frame
+        mutable std::vector<real> position_x;
+        mutable std::vector<real> position_y;
+        mutable std::vector<real> position_z;
+        // radius of every particle, filled by gather_radii for broadphases that need them all
+        mutable std::vector<real> point_radius;
+
+        // store slot of every particle, filled by add_contacts
+        mutable std::vector<unsigned> slots;
+
+        // where collide writes, ParticleContacts from contact on or, when compact is set, slots appended to it
+        struct ContactOutput
+        {
+            ParticleContact *contact;
+            ParticleCompactContacts *compact;
+        };
+
+        real get_radius(unsigned i) const;
+        real get_max_radius() const;
+        void gather_positions() const;
+        void gather_radii() const;
+        // writes a contact pushing i and j apart if they overlap, returns the number written
+        unsigned sphere_contact(unsigned i, unsigned j, ContactOutput &out) const;
+        // writes at most limit contacts to out, for both add_contact and add_contacts
+        virtual unsigned collide(ContactOutput &out, unsigned limit) const = 0;
+
+    public:
+        ParticleCollisionGenerator();
+
+        void init(ParticleWorld::Particles *particles, real radius, real restitution);
+        void set_radii(const std::vector<real> *radii);
+
+        virtual unsigned add_contact(ParticleContact *contact, unsigned limit) const;
+        // falls back to ParticleContactGenerator::add_contacts when the particles arent all in the table's store
+        virtual unsigned add_contacts(ParticleCompactContacts &contacts, unsigned limit) const;
+    };
+
+    // collision detection through a ParticleSpatialHash rebuilt every frame
+    // only pairs in neighbouring cells are tested, cell size follows the largest radius
+    class ParticleHashCollisions : public ParticleCollisionGenerator
+    {
+        mutable ParticleSpatialHash hash;
+
+        virtual unsigned collide(ContactOutput &out, unsigned limit) const;
+    };
+
+    // collision detection through a ParticleSweepAndPrune kept sorted between frames
+    // unlike the hash it doesnt depend on one cell size, so mixed radii and clumped scenes dont slow it down
+    class ParticleSweepCollisions : public ParticleCollisionGenerator
+    {
+        mutable ParticleSweepAndPrune sweep;
+
+        virtual unsigned collide(ContactOutput &out, unsigned limit) const;
+    };
+
+    // collisions against static boxes through a ParticleAABBTree that also holds every particle
+    // particles are only reinserted when they leave their fat box so thousands of obstacles cost
+    // a tree query per particle rather than a scan, particle pairs come out of the same tree
+    class ParticleTreeCollisions : public ParticleCollisionGenerator
+    {
+    public:
+        enum Category
+        {
+            OBSTACLE = 1,
+            PARTICLE = 2
+        };
+
+    protected:
+        mutable ParticleAABBTree tree;
+        std::vector<ParticleAABB> obstacles;
+        mutable std::vector<unsigned> particle_proxies;
+        // how far a particle's box is fattened past its radius, in multiples of its radius
+        real margin;
+        bool collide_particles;
+
+        unsigned box_contact(unsigned i, const ParticleAABB &box, ContactOutput &out) const;
+        void update_particles() const;
+        virtual unsigned collide(ContactOutput &out, unsigned limit) const;
+
+    public:
+        ParticleTreeCollisions(real margin = 0.5f);
+
+        // boxes can be flat or points, e.g. a ground plane or an anchor
+        void add_obstacle(const Vector3 &min, const Vector3 &max);
+        void clear_obstacles();
+        unsigned get_obstacle_count() const;
+        // off leaves particle pairs to another generator and only tests particles against obstacles
+        void set_collide_particles(bool collide_particles);
+        ParticleAABBTree &get_tree();
+    };
+}
+
+#endif // !GABBYPHYSICS_PBROADPHASE_H
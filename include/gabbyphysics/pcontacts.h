@@ -2,9 +2,41 @@
 #define GABBYPHYSICS_PCONTACTS_H
 
 #include "particle.h"
+#include "pjobs.h"
+
+#include "functional"
+#include "unordered_map"
+#include "vector"
 
 namespace gabbyphysics
 {
+    // the store slot a particle's state lives in, every Particle view of one slot gets the same key
+    // keeps the handle rather than the slot so the key still matches after ParticleStore::permute
+    struct ParticleKey
+    {
+        const ParticleStore *store;
+        ParticleStore::Handle handle;
+
+        // a null particle, e.g. the missing side of a particle-scenery contact, gets a key matching no particle
+        ParticleKey(const Particle *particle)
+            : store(particle ? particle->get_store() : NULL),
+              handle(particle ? particle->get_handle() : ParticleStore::INVALID_HANDLE)
+        {
+        }
+
+        bool operator==(const ParticleKey &other) const
+        {
+            return store == other.store && handle == other.handle;
+        }
+
+        bool operator<(const ParticleKey &other) const
+        {
+            if (store != other.store)
+                return std::less<const ParticleStore *>()(store, other.store);
+            return handle < other.handle;
+        }
+    };
+
     class ParticleContact
     {
     public:
@@ -20,27 +52,283 @@ namespace gabbyphysics
         real calculate_separating_velocity() const;
 
     private:
+        friend class ParticleContactResolver;
+        friend class ParticleContactSolver;
+
         void resolve_velocity(real duration);
-        void resolve_interpenetration(real duration);
+        // movement gets how far each particle was moved, zero for a missing one
+        void resolve_interpenetration(real duration, Vector3 movement[2]);
+    };
+
+    // contacts for the iterative resolver, soa with particles referred to by their slot in one ParticleStore
+    // generators write them straight in through ParticleContactGenerator::add_contacts and the resolver works on the
+    // store's arrays in place, so nothing is copied in or out. particle-scenery contacts have their own columns
+    // so neither set needs a check for the missing particle
+    class ParticleCompactContacts
+    {
+    public:
+        // one entry per contact in every column, second is left empty for scenery contacts
+        struct Columns
+        {
+            std::vector<unsigned> first;
+            std::vector<unsigned> second;
+            // see pack_normal
+            std::vector<unsigned> normal;
+            std::vector<real> restitution;
+            std::vector<real> penetration;
+
+            unsigned size() const { return first.size(); }
+        };
+
+        // where one run of contacts starts or ends in both sets of columns
+        struct Mark
+        {
+            unsigned pairs;
+            unsigned scenery;
+        };
+
+        Columns pairs;
+        Columns scenery;
+
+    protected:
+        ParticleStore *store;
+        bool mixed;
+
+    public:
+        ParticleCompactContacts();
+
+        // binds the table to store if it has none yet, false if it already refers to another store's slots
+        bool use_store(ParticleStore *store);
+        // the store the slots index, 0 until the first contact is added
+        ParticleStore *get_store() const { return store; }
+        // a contact whose particles arent all in the table's store was dropped, the table cant be resolved
+        bool is_mixed() const { return mixed; }
+
+        // contacts with a zero normal are skipped, they move nothing when resolved
+        void add(unsigned first, unsigned second, const Vector3 &normal, real penetration, real restitution);
+        void add(unsigned first, const Vector3 &normal, real penetration, real restitution);
+        // looks contact's particles up in their store, which use_store has to accept
+        void add(const ParticleContact &contact);
+        // copies other's contacts between from and to, other's store has to be this table's
+        void append(const ParticleCompactContacts &other, Mark from, Mark to);
+        void reserve(unsigned capacity);
+        // forgets the store too
+        void clear();
+
+        Mark mark() const { return {pairs.size(), scenery.size()}; }
+        unsigned size() const { return pairs.size() + scenery.size(); }
+        // contacts the columns hold without growing
+        unsigned capacity() const { return pairs.first.capacity() + scenery.first.capacity(); }
+
+        // octahedral encoding of a unit vector, x and y of its projection on to the octahedron in 16 bits each
+        // axis aligned normals come back exactly, others within about 1e-4
+        static unsigned pack_normal(const Vector3 &normal);
+        static Vector3 unpack_normal(unsigned packed);
+    };
+
+    // contacts grouped by the movable particles they touch
+    // resolving a contact only changes velocities and penetrations of contacts in these groups
+    class ParticleContactNeighbours
+    {
+    protected:
+        struct ParticleContactRef
+        {
+            ParticleKey particle;
+            unsigned contact;
+            unsigned side;
+        };
+        std::vector<ParticleContactRef> particle_contacts;
+        // per contact and side, the range of particle_contacts sharing that particle
+        std::vector<unsigned> neighbour_begin;
+        std::vector<unsigned> neighbour_end;
+
+    public:
+        void build(const ParticleContact *contact_array, unsigned num_contacts);
+
+        // [begin, end) indexes get_contact, every contact touching particle[side] of contact, itself included
+        // empty when that particle is missing or immovable
+        unsigned begin(unsigned contact, unsigned side) const { return neighbour_begin[contact * 2 + side]; }
+        unsigned end(unsigned contact, unsigned side) const { return neighbour_end[contact * 2 + side]; }
+        unsigned get_contact(unsigned n) const { return particle_contacts[n].contact; }
+        // every contact touching either particle of contact once, itself included
+        void gather(unsigned contact, std::vector<unsigned> &out) const;
+    };
+
+    // greedy colouring of the contact graph, contacts of one colour share no movable particle
+    // so a colour can be resolved on several threads at once without races
+    class ParticleContactColouring
+    {
+    public:
+        // contacts that couldnt get one of the first MAX_COLOURS colours go in a last batch that runs serially
+        const static unsigned MAX_COLOURS = 64;
+
+    protected:
+        std::vector<unsigned> colours;
+        std::vector<unsigned> order;
+        std::vector<unsigned> batch_start;
+        std::vector<unsigned> next;
+        std::vector<unsigned> touched;
+
+    public:
+        void build(const ParticleContactNeighbours &neighbours, unsigned num_contacts);
+
+        // batches are [0, get_batch_count()), batch MAX_COLOURS is only there when some contacts overflowed
+        unsigned get_batch_count() const { return batch_start.size() - 1; }
+        bool is_parallel(unsigned batch) const { return batch < MAX_COLOURS; }
+        const unsigned *begin(unsigned batch) const { return order.data() + batch_start[batch]; }
+        const unsigned *end(unsigned batch) const { return order.data() + batch_start[batch + 1]; }
     };
 
     class ParticleContactResolver
     {
+    public:
+        enum Mode
+        {
+            // rescans every contact each iteration for the largest closing velocity, O(iterations * contacts)
+            ITERATIVE,
+            // keeps contacts in a heap on separating velocity and only rescores the contacts sharing a particle
+            // with the one just resolved, O(contacts + iterations * neighbours * log contacts)
+            PRIORITY
+        };
+
     protected:
         unsigned iterations;
         unsigned iterations_used;
+        Mode mode;
+        // stop once the largest closing velocity is slower than this
+        real velocity_epsilon;
+
+        // compact mode scratch, kept between frames to avoid reallocating
+        // every movable side of every contact sorted by slot, pair contacts numbered first and scenery contacts after them
+        // only slots in the table are indexed, so building it costs O(contacts log contacts) whatever the store's size
+        struct SlotContact
+        {
+            unsigned slot;
+            unsigned contact;
+            unsigned side;
+        };
+        std::vector<SlotContact> slot_contacts;
+        // per contact and side, the range of slot_contacts sharing that side's slot, empty when it is immovable
+        std::vector<unsigned> slot_contacts_begin;
+        std::vector<unsigned> slot_contacts_end;
+        std::vector<real> scenery_separating_velocity;
+        // 1 / the length of each contact's normal as it unfolds, so the scans dont take a square root every iteration
+        std::vector<real> normal_scale;
+        std::vector<real> scenery_normal_scale;
+
+        // priority mode scratch
+        ParticleContactNeighbours neighbours;
+        std::vector<unsigned> touched;
+        std::vector<real> separating_velocity;
+        std::vector<unsigned> heap;
+        std::vector<unsigned> heap_position;
+
+        void resolve_contacts_iterative(ParticleContact *contact_array, unsigned num_contacts, real duration);
+        void resolve_contacts_priority(ParticleContact *contact_array, unsigned num_contacts, real duration);
+        void build_slot_contacts(const ParticleCompactContacts &contacts, const ParticleStore &store);
+        // ParticleContact::resolve on contact i of columns with its unpacked normal
+        // movement gets how far each of its particles was moved
+        void resolve_compact(ParticleStore &store, ParticleCompactContacts::Columns &columns, bool scenery, unsigned i,
+                             const Vector3 &normal, real separating, real duration, Vector3 movement[2]);
+        void heap_swap(unsigned a, unsigned b);
+        void sift_up(unsigned position);
+        void sift_down(unsigned position);
 
     public:
-        ParticleContactResolver(unsigned iterations);
+        ParticleContactResolver(unsigned iterations, Mode mode = ITERATIVE);
 
         void set_iterations(unsigned iterations);
+        void set_mode(Mode mode);
+        Mode get_mode() const;
+        void set_velocity_epsilon(real velocity_epsilon);
+        unsigned get_iterations_used() const;
         void resolve_contacts(ParticleContact *contact_array, unsigned num_contacts, real duration);
+        // always iterative, the per iteration scan decodes the normals and gathers velocities straight from the store
+        // penetrations are kept up to date in contacts, contacts mustnt be mixed
+        void resolve_contacts(ParticleCompactContacts &contacts, real duration);
+    };
+
+    // projected gauss-seidel over all contacts with a fixed number of sweeps
+    // every sweep visits each contact once and clamps its accumulated impulse to be non negative
+    // impulses are warm started from the previous frame's contact between the same pair of particles
+    // only pairs with a single contact in both frames are warm started, particle-scenery contacts have no pair
+    // to tell a particle's ground contact from its other scenery contacts by, so they always start from zero
+    class ParticleContactSolver
+    {
+    protected:
+        // the particles in ParticleKey order, so a pair is found whichever way round a generator wrote it
+        // and whichever Particle views of the two slots it used
+        struct ContactKey
+        {
+            ParticleKey first;
+            ParticleKey second;
+
+            bool operator==(const ContactKey &other) const
+            {
+                return first == other.first && second == other.second;
+            }
+        };
+
+        struct ContactKeyHash
+        {
+            size_t operator()(const ContactKey &key) const;
+        };
+
+        struct WarmStart
+        {
+            real impulse;
+            // as seen from ContactKey::first
+            Vector3 normal;
+            // contacts with this key in the frame, their impulses are only kept when there is one
+            unsigned count;
+        };
+
+        typedef std::unordered_map<ContactKey, WarmStart, ContactKeyHash> WarmStarts;
+
+        unsigned sweeps;
+        // fraction of last frame's impulse applied up front, 0 disables warm starting
+        real warm_start_factor;
+        WarmStarts previous_impulses;
+        WarmStarts current_impulses;
+
+        // per contact state for the current solve
+        std::vector<real> effective_mass;
+        std::vector<real> target_velocity;
+        std::vector<real> accumulated_impulse;
+        ParticleContactNeighbours neighbours;
+        std::vector<unsigned> touched;
+        ParticleContactColouring colouring;
+
+        // normal gets the contact normal as seen from the key's first particle
+        static ContactKey make_key(const ParticleContact &contact, Vector3 &normal);
+        void apply_impulse(ParticleContact &contact, real impulse);
+        void solve_contact(ParticleContact &contact, unsigned i);
+        void sweep(ParticleContact *contact_array, unsigned num_contacts, JobPool *pool);
+
+    public:
+        ParticleContactSolver(unsigned sweeps = 8, real warm_start_factor = 0.8f);
+
+        void set_sweeps(unsigned sweeps);
+        unsigned get_sweeps() const;
+        void set_warm_start_factor(real warm_start_factor);
+        // forgets last frame's impulses, e.g. after teleporting particles
+        void reset_warm_start();
+        // with a pool of more than one thread each sweep resolves one colour of the contact graph at a time in parallel
+        void solve_contacts(ParticleContact *contact_array, unsigned num_contacts, real duration, JobPool *pool = 0);
     };
 
     class ParticleContactGenerator
     {
     public:
+        // writes at most limit contacts from contact on and returns how many were written
+        // when it returns exactly limit ParticleWorld runs it again in the same frame with more room, so two calls
+        // with the particles unchanged in between have to write the same contacts. state kept between calls, like
+        // the broadphase sort orders and trees, must only cache the particles and be brought up to date by each call
         virtual unsigned add_contact(ParticleContact *contact, unsigned limit) const = 0;
+        // the same contacts appended to contacts, at most limit of them, returns how many were written
+        // by default they go through add_contact and are looked up in their store one by one, generators with many
+        // contacts write slots directly. ParticleWorld can call both in one frame, so they follow the same rules
+        virtual unsigned add_contacts(ParticleCompactContacts &contacts, unsigned limit) const;
     };
 }
 
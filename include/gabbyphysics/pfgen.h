@@ -2,12 +2,16 @@
 #define GABBYPHYSICS_PFGEN_H
 
 #include "particle.h"
+#include "pjobs.h"
 #include "precision.h"
 
+#include "unordered_map"
 #include "vector"
 
 namespace gabbyphysics
 {
+    // generators may run on several threads at once but only for different particles
+    // update_force must only write to the particle it is given
     class ParticleForceGenerator
     {
     public:
@@ -16,28 +20,198 @@ namespace gabbyphysics
 
     class ParticleForceRegistry
     {
+    public:
+        enum Mode
+        {
+            // one virtual update_force call per registration in registration order
+            VIRTUAL,
+            // registrations of the built in generators are grouped by concrete type and each group runs
+            // as one loop over packed parameters, subclasses and other generators still go through update_force
+            BATCHED
+        };
+
+        // stays valid until the registration is removed, even when other registrations get moved around
+        // the low HANDLE_INDEX_BITS pick the entry in slots, the bits above count how many times that entry was reused
+        // so a handle kept past remove doesnt pass is_valid or remove someone else's registration
+        typedef unsigned Handle;
+        const static Handle INVALID_HANDLE = 0xffffffff;
+        const static unsigned HANDLE_INDEX_BITS = 24;
+        const static unsigned HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+
     protected:
+        enum BatchType
+        {
+            GRAVITY,
+            DRAG,
+            SPRING,
+            ANCHORED_SPRING,
+            BUNGEE,
+            BUOYANCY,
+            // any other generator type, run through update_force
+            OTHER
+        };
+
         struct ParticleForceRegistration
         {
             Particle *particle;
             ParticleForceGenerator *fg;
+            Handle handle;
+            // neighbours in the list of registrations of the same particle, in registration order
+            Handle previous;
+            Handle next;
+            // where the registration sits in the batches while they are built
+            BatchType batch;
+            unsigned batch_index;
         };
 
         typedef std::vector<ParticleForceRegistration> Registry;
+        // dense, removal moves the last registration into the gap
         Registry registrations;
 
+        // handle index -> index into registrations, INVALID_HANDLE marks a free entry
+        std::vector<unsigned> slots;
+        // handles of removed registrations, add reuses their entry with the next generation
+        std::vector<Handle> free_handles;
+
+        // every particle with at least one registration and the ends of its registration list
+        // threads split the work by particle so no two threads push the same one
+        struct ParticleRegistrations
+        {
+            Particle *particle;
+            Handle first;
+            Handle last;
+        };
+        std::vector<ParticleRegistrations> registered_particles;
+        std::unordered_map<const Particle *, unsigned> particle_index;
+
+        ParticleForceRegistration &get_registration(Handle handle) { return registrations[slots[handle & HANDLE_INDEX_MASK]]; }
+        void link(ParticleForceRegistration &registration);
+        void unlink(ParticleForceRegistration &registration);
+
+        // packed parameters of one generator type, forces are computed into force_x/y/z then added serially
+        // particle state is read from and forces added to the store arrays directly, by the slots compute looks up
+        struct ForceBatch
+        {
+            std::vector<Particle *> particles;
+            std::vector<Handle> handles;
+            std::vector<real> force_x;
+            std::vector<real> force_y;
+            std::vector<real> force_z;
+            // where each particle was when compute last ran, particles can move between stores and slots between frames
+            std::vector<ParticleStore *> stores;
+            std::vector<unsigned> slots;
+
+            void add(Particle *particle, Handle handle);
+            void clear();
+            // swap and pop, returns the handle now at index or INVALID_HANDLE if index was last
+            Handle remove(unsigned index);
+            unsigned size() const { return particles.size(); }
+            // looks up and records the store and slot of particle i
+            ParticleStore &locate(unsigned i);
+            // adds every computed force to its particle's slot
+            void apply() const;
+            void store(unsigned begin, unsigned count, const real *x, const real *y, const real *z);
+        };
+
+        struct GravityBatch : ForceBatch
+        {
+            std::vector<real> gravity_x;
+            std::vector<real> gravity_y;
+            std::vector<real> gravity_z;
+
+            void compute(unsigned begin, unsigned end);
+            void clear();
+            Handle remove(unsigned index);
+        };
+
+        struct DragBatch : ForceBatch
+        {
+            std::vector<real> k1;
+            std::vector<real> k2;
+
+            void compute(unsigned begin, unsigned end);
+            void clear();
+            Handle remove(unsigned index);
+        };
+
+        // the other end is a particle, or for anchored springs a null particle and an anchor
+        struct SpringBatch : ForceBatch
+        {
+            std::vector<Particle *> others;
+            std::vector<Vector3 *> anchors;
+            std::vector<real> spring_constant;
+            std::vector<real> rest_length;
+
+            void compute(unsigned begin, unsigned end);
+            void clear();
+            Handle remove(unsigned index);
+            // offset between both ends and the parameters of [begin, begin + count)
+            void gather(unsigned begin, unsigned count, real *x, real *y, real *z, real *k, real *rest);
+        };
+
+        struct BungeeBatch : SpringBatch
+        {
+            void compute(unsigned begin, unsigned end);
+        };
+
+        struct BuoyancyBatch : ForceBatch
+        {
+            std::vector<real> max_depth;
+            std::vector<real> volume;
+            std::vector<real> liquid_height;
+            std::vector<real> liquid_density;
+
+            void compute(unsigned begin, unsigned end);
+            void clear();
+            Handle remove(unsigned index);
+        };
+
+        Mode mode;
+        bool batches_dirty;
+        GravityBatch gravity;
+        DragBatch drag;
+        SpringBatch springs;
+        SpringBatch anchored_springs;
+        BungeeBatch bungees;
+        BuoyancyBatch buoyancy;
+        // registrations of any other generator type
+        std::vector<Handle> others;
+
+        void build_batches();
+        void batch_registration(ParticleForceRegistration &registration);
+        void unbatch_registration(const ParticleForceRegistration &registration);
+        void update_batches(real duration, JobPool *pool);
+
     public:
-        void add(Particle *particle, ParticleForceGenerator *fg);
+        ParticleForceRegistry();
 
+        Handle add(Particle *particle, ParticleForceGenerator *fg);
+
+        // all removals are o(1) per registration removed, the order registrations run in may change
+        void remove(Handle handle);
+        // the first registration of fg on particle, if any
         void remove(Particle *particle, ParticleForceGenerator *fg);
+        // every registration on particle, e.g. before destroying it
+        void remove_particle(Particle *particle);
 
         void clear();
 
+        bool is_valid(Handle handle) const;
+        unsigned size() const;
+
+        void set_mode(Mode mode);
+        Mode get_mode() const;
+
         void update_forces(real duration);
+        // splits the registrations across the pool, all registrations for a particle run on the same thread
+        // in batched mode forces are computed in parallel and added to the particles on the calling thread
+        void update_forces(real duration, JobPool *pool);
     };
 
     class ParticleGravity : public ParticleForceGenerator
     {
+        friend class ParticleForceRegistry;
+
         Vector3 gravity;
 
     public:
@@ -48,6 +222,8 @@ namespace gabbyphysics
 
     class ParticleDrag : public ParticleForceGenerator
     {
+        friend class ParticleForceRegistry;
+
         // velocity drag coeff
         real k1;
         // velocity^2 drag coeff
@@ -61,6 +237,8 @@ namespace gabbyphysics
 
     class ParticleSpring : public ParticleForceGenerator
     {
+        friend class ParticleForceRegistry;
+
         Particle *other;
         real spring_constant;
         real rest_length;
@@ -73,6 +251,8 @@ namespace gabbyphysics
 
     class ParticleAnchoredSpring : public ParticleForceGenerator
     {
+        friend class ParticleForceRegistry;
+
         Vector3 *anchor;
         real spring_constant;
         real rest_length;
@@ -85,6 +265,8 @@ namespace gabbyphysics
 
     class ParticleBungee : public ParticleForceGenerator
     {
+        friend class ParticleForceRegistry;
+
         Particle *other;
         real spring_constant;
         real rest_length;
@@ -97,6 +279,8 @@ namespace gabbyphysics
 
     class ParticleBuoyancy : public ParticleForceGenerator
     {
+        friend class ParticleForceRegistry;
+
         real max_depth;
         real volume;        // object volume
         real liquid_height; // height above y=0 parallel to XZ plane
@@ -107,6 +291,107 @@ namespace gabbyphysics
 
         virtual void update_force(Particle *particle, real duration);
     };
+
+    // a block of particles handed to a ParticleForceField
+    // inputs are gathered into contiguous arrays padded with zeros to a multiple of GABBYPHYSICS_SIMD_WIDTH
+    // fields overwrite force_x/y/z for every lane, the world masks out particles outside the field's layers
+    struct ParticleFieldBlock
+    {
+        const static unsigned SIZE = 256;
+
+        // lanes to compute, count rounded up to the simd width
+        unsigned lanes;
+        real position_x[SIZE];
+        real position_y[SIZE];
+        real position_z[SIZE];
+        real velocity_x[SIZE];
+        real velocity_y[SIZE];
+        real velocity_z[SIZE];
+        real inverse_mass[SIZE];
+        real force_x[SIZE];
+        real force_y[SIZE];
+        real force_z[SIZE];
+    };
+
+    // a force every particle of a ParticleWorld feels without being registered for it
+    // costs o(1) memory however many particles it pushes and runs as one sweep over them
+    // compute may run on several threads at once for different blocks
+    class ParticleForceField
+    {
+    public:
+        const static unsigned ALL_LAYERS = 0xffffffff;
+
+        // only particles with a layer bit in mask are pushed
+        unsigned mask;
+
+        ParticleForceField();
+
+        virtual void compute(ParticleFieldBlock &block, real duration) const = 0;
+    };
+
+    // same force as a ParticleGravity registered on every particle
+    class ParticleGravityField : public ParticleForceField
+    {
+    public:
+        Vector3 gravity;
+
+        ParticleGravityField(const Vector3 &gravity);
+
+        virtual void compute(ParticleFieldBlock &block, real duration) const;
+    };
+
+    // same force as a ParticleDrag registered on every particle
+    class ParticleDragField : public ParticleForceField
+    {
+    public:
+        real k1;
+        real k2;
+
+        ParticleDragField(real k1, real k2);
+
+        virtual void compute(ParticleFieldBlock &block, real duration) const;
+    };
+
+    // pushes particles towards the wind's velocity, in proportion to how much slower than it they move
+    class ParticleWindField : public ParticleForceField
+    {
+    public:
+        Vector3 velocity;
+        real coefficient;
+
+        ParticleWindField(const Vector3 &velocity, real coefficient);
+
+        virtual void compute(ParticleFieldBlock &block, real duration) const;
+    };
+
+    // same force as a ParticleBuoyancy registered on every particle, the liquid fills everything below liquid_height
+    class ParticleBuoyancyField : public ParticleForceField
+    {
+    public:
+        real max_depth;
+        real volume;
+        real liquid_height;
+        real liquid_density;
+
+        ParticleBuoyancyField(real max_depth, real volume, real liquid_height, real liquid_density = 1000.0f);
+
+        virtual void compute(ParticleFieldBlock &block, real duration) const;
+    };
+
+    // pulls particles within radius of centre towards it with strength * mass / distance^2
+    // softening keeps the pull finite for particles right at the centre
+    class ParticleAttractorField : public ParticleForceField
+    {
+    public:
+        Vector3 centre;
+        real strength;
+        real radius;
+        real softening;
+
+        ParticleAttractorField(const Vector3 &centre, real strength, real radius, real softening = 0.1f);
+
+        virtual void compute(ParticleFieldBlock &block, real duration) const;
+    };
 }
 
 #endif // !GABBYPHYSICS_PFGEN_H
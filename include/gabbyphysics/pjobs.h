@@ -0,0 +1,77 @@
+#ifndef GABBYPHYSICS_PJOBS_H
+#define GABBYPHYSICS_PJOBS_H
+
+// single threaded wasm builds have no std::thread, a pool there runs every job on the calling thread
+#if defined(__wasi__) && !defined(_REENTRANT)
+#define GABBYPHYSICS_THREADS 0
+#else
+#define GABBYPHYSICS_THREADS 1
+#endif
+
+#include "functional"
+#include "memory"
+#include "vector"
+
+#if GABBYPHYSICS_THREADS
+#include "atomic"
+#include "condition_variable"
+#include "deque"
+#include "mutex"
+#include "thread"
+#endif
+
+namespace gabbyphysics
+{
+    // fork/join pool for splitting a phase of the simulation across cores
+    // each thread owns a queue of ranges, pops its own from the back and steals from the front of the others when it runs dry
+    class JobPool
+    {
+    public:
+        // called with a half open range [begin, end) and the index of the thread running it, [0, get_thread_count())
+        typedef std::function<void(unsigned begin, unsigned end, unsigned thread)> RangeJob;
+
+    protected:
+        unsigned thread_count;
+
+#if GABBYPHYSICS_THREADS
+        struct Range
+        {
+            unsigned begin;
+            unsigned end;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Range> ranges;
+        };
+
+        std::vector<std::thread> workers;
+        std::unique_ptr<Queue[]> queues;
+        const RangeJob *job;
+        std::atomic<unsigned> pending;
+
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        unsigned generation;
+        bool stopping;
+
+        bool pop(unsigned thread, Range &range);
+        void run(unsigned thread);
+        void worker_main(unsigned thread);
+#endif
+
+    public:
+        // threads includes the calling thread, 0 uses one per hardware thread
+        JobPool(unsigned threads = 0);
+        ~JobPool();
+
+        unsigned get_thread_count() const;
+
+        // splits [0, count) into ranges of at most chunk_size and blocks until all of them have run
+        // the calling thread works through ranges too, calls must not be nested
+        void parallel_for(unsigned count, unsigned chunk_size, const RangeJob &job);
+    };
+}
+
+#endif // !GABBYPHYSICS_PJOBS_H
@@ -19,6 +19,8 @@ namespace gabbyphysics
         // maximum number of contact in the array
         // returns the number of contacts that have been written
         virtual unsigned add_contact(ParticleContact *contact, unsigned limit) const = 0;
+        // the one contact goes straight in, without the buffer ParticleContactGenerator::add_contacts keeps
+        virtual unsigned add_contacts(ParticleCompactContacts &contacts, unsigned limit) const;
     };
 
     class ParticleCable : public ParticleLink
@@ -54,6 +56,7 @@ namespace gabbyphysics
 
     public:
         virtual unsigned add_contact(ParticleContact *contact, unsigned limit) const = 0;
+        virtual unsigned add_contacts(ParticleCompactContacts &contacts, unsigned limit) const;
     };
 
     class ParticleCableConstraint : public ParticleConstraint
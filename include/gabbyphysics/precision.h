@@ -5,15 +5,62 @@
 #include "float.h"
 #include "math.h"
 
+// one real per build, the library and everything linking it must agree
+// define GABBYPHYSICS_DOUBLE_PRECISION for doubles, e.g. big worlds that drift far from the origin
+// define GABBYPHYSICS_FIXED_POINT for deterministic 32.32 fixed point, e.g. lockstep multiplayer
+// floats otherwise
+#if defined(GABBYPHYSICS_DOUBLE_PRECISION) && defined(GABBYPHYSICS_FIXED_POINT)
+#error "GABBYPHYSICS_DOUBLE_PRECISION and GABBYPHYSICS_FIXED_POINT are exclusive"
+#endif
+
+#if defined(GABBYPHYSICS_FIXED_POINT)
+#include "fixed.h"
+#endif
+
 namespace gabbyphysics
 {
+#if defined(GABBYPHYSICS_DOUBLE_PRECISION)
+    typedef double real;
+#define real_sqrt sqrt
+#define real_pow pow
+#define real_abs fabs
+#define real_fmod fmod
+#define real_floor floor
+
+#define REAL_MAX DBL_MAX
+#define GABBYPHYSICS_PRECISION_NAME "double"
+#elif defined(GABBYPHYSICS_FIXED_POINT)
+    typedef fixed real;
+#define real_sqrt fixed_sqrt
+#define real_pow fixed_pow
+#define real_abs fixed_abs
+#define real_fmod fixed_fmod
+#define real_floor fixed_floor
+
+#define REAL_MAX fixed::from_raw(LLONG_MAX)
+#define GABBYPHYSICS_PRECISION_NAME "fixed"
+#else
     typedef float real;
 #define real_sqrt sqrtf
 #define real_pow powf
 #define real_abs fabsf
 #define real_fmod fmodf
+#define real_floor floorf
 
 #define REAL_MAX FLT_MAX
+#define GABBYPHYSICS_PRECISION_NAME "float"
+#endif
+
 }
 
+// reals per Vector3, see core.h
+// 3 packs them so particles, contacts and anything copied across the wasm boundary carry no dead lane, 12 bytes with float
+// define GABBYPHYSICS_PAD_VECTOR3 for 4, the old 16 byte layout with a hidden fourth real
+// math that wants a whole vector in one register converts to Vector4 from simd.h either way
+#if defined(GABBYPHYSICS_PAD_VECTOR3)
+#define GABBYPHYSICS_VECTOR3_REALS 4
+#else
+#define GABBYPHYSICS_VECTOR3_REALS 3
+#endif
+
 #endif // !GABBYPHYSICS_PRECISION_H
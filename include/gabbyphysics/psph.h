@@ -0,0 +1,268 @@
+#ifndef GABBYPHYSICS_PSPH_H
+#define GABBYPHYSICS_PSPH_H
+
+#include "pbroadphase.h"
+#include "pjobs.h"
+#include "pstore.h"
+#include "simd.h"
+
+#include "vector"
+
+namespace gabbyphysics
+{
+    // smoothing kernels for SphFluid, picked at compile time so the passes inline them
+    // value is the weight of a neighbour at distance, derivative its slope along distance, both 0 from radius out
+    // DIMENSIONS sets the scale so the kernel integrates to 1 over a disc (2) or a ball (3)
+
+    // (radius - distance)^2, sharp at the centre so close particles push apart hard, the kernel WaterSim started with
+    template <unsigned DIMENSIONS = 3>
+    struct SphSpikyKernel
+    {
+        real radius;
+        real scale;
+
+        SphSpikyKernel(real radius) : radius(radius)
+        {
+            const real pi = real(3.14159265f);
+            real h2 = radius * radius;
+            scale = DIMENSIONS == 2 ? 6 / (pi * h2 * h2) : 15 / (2 * pi * h2 * h2 * radius);
+        }
+
+        real value(real distance) const
+        {
+            if (distance >= radius)
+                return 0;
+            real d = radius - distance;
+            return d * d * scale;
+        }
+
+        real derivative(real distance) const
+        {
+            if (distance >= radius)
+                return 0;
+            return (distance - radius) * 2 * scale;
+        }
+    };
+
+    // (radius^2 - distance^2)^3, flat at the centre, smoother densities but weak pressure between close particles
+    template <unsigned DIMENSIONS = 3>
+    struct SphPoly6Kernel
+    {
+        real radius;
+        real scale;
+
+        SphPoly6Kernel(real radius) : radius(radius)
+        {
+            const real pi = real(3.14159265f);
+            real h2 = radius * radius;
+            real h8 = h2 * h2 * h2 * h2;
+            scale = DIMENSIONS == 2 ? 4 / (pi * h8) : 315 / (64 * pi * h8 * radius);
+        }
+
+        real value(real distance) const
+        {
+            if (distance >= radius)
+                return 0;
+            real d = radius * radius - distance * distance;
+            return d * d * d * scale;
+        }
+
+        real derivative(real distance) const
+        {
+            if (distance >= radius)
+                return 0;
+            real d = radius * radius - distance * distance;
+            return -6 * distance * d * d * scale;
+        }
+    };
+
+    // every particle of a ParticleStore within radius of each particle, found through a ParticleSpatialHash once per build
+    // lists are kept per chunk of CHUNK particles so chunks can be built on different threads,
+    // the result is the same whatever the thread count
+    class SphNeighbours
+    {
+    public:
+        const static unsigned CHUNK = 1024;
+
+    protected:
+        ParticleSpatialHash hash;
+        // neighbours of a chunk's particles back to back, with the distance to each
+        std::vector<std::vector<unsigned>> chunk_indices;
+        std::vector<std::vector<real>> chunk_distances;
+        // per particle, where its neighbours start in its chunk's lists and how many there are
+        std::vector<unsigned> list_begin;
+        std::vector<unsigned> list_count;
+
+    public:
+        // a particle is never its own neighbour
+        void build(const ParticleStore &store, real radius, JobPool *jobs = 0);
+
+        unsigned size() const { return list_count.size(); }
+        unsigned count(unsigned i) const { return list_count[i]; }
+        const unsigned *indices(unsigned i) const { return chunk_indices[i / CHUNK].data() + list_begin[i]; }
+        const real *distances(unsigned i) const { return chunk_distances[i / CHUNK].data() + list_begin[i]; }
+
+        // runs job over [0, count) in CHUNK sized ranges, on jobs if there is one
+        static void for_each_range(JobPool *jobs, unsigned count, const JobPool::RangeJob &job);
+    };
+
+    // smoothed particle hydrodynamics over the particles of a ParticleStore
+    // apply adds pressure and viscosity forces, so it goes between ParticleWorld::start_frame and run_physics:
+    //     world.start_frame();
+    //     fluid.apply(world.get_particle_store(), world.get_job_pool());
+    //     world.run_physics(duration);
+    // each apply builds the neighbour lists once, then a density pass and a pressure and viscosity pass read only them
+    template <typename Kernel = SphSpikyKernel<3>>
+    class SphFluid
+    {
+    protected:
+        Kernel kernel;
+        real target_density;
+        real stiffness;
+        real viscosity;
+
+        SphNeighbours neighbours;
+        std::vector<real> masses;
+        std::vector<real> densities;
+        std::vector<real> pressures;
+
+        void compute_densities(unsigned begin, unsigned end);
+        void compute_forces(ParticleStore &store, unsigned begin, unsigned end);
+
+    public:
+        // pressure is stiffness * (density - target_density), viscosity pulls neighbours towards each other's velocity
+        SphFluid(real radius, real target_density, real stiffness, real viscosity = 0);
+
+        void set_radius(real radius);
+        real get_radius() const { return kernel.radius; }
+        void set_target_density(real target_density);
+        void set_stiffness(real stiffness);
+        void set_viscosity(real viscosity);
+
+        // immovable particles have no mass, so they add nothing to their neighbours' density and get no force
+        void apply(ParticleStore &store, JobPool *jobs = 0);
+
+        // densities from the last apply, indexed by slot
+        const std::vector<real> &get_densities() const { return densities; }
+        const SphNeighbours &get_neighbours() const { return neighbours; }
+    };
+
+    // unit direction to push apart particles i and j sitting on the same point, the same every frame for the same pair
+    Vector3 sph_coincident_direction(unsigned i, unsigned j);
+
+    template <typename Kernel>
+    SphFluid<Kernel>::SphFluid(real radius, real target_density, real stiffness, real viscosity)
+        : kernel(radius), target_density(target_density), stiffness(stiffness), viscosity(viscosity)
+    {
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::set_radius(real radius)
+    {
+        kernel = Kernel(radius);
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::set_target_density(real target_density)
+    {
+        SphFluid::target_density = target_density;
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::set_stiffness(real stiffness)
+    {
+        SphFluid::stiffness = stiffness;
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::set_viscosity(real viscosity)
+    {
+        SphFluid::viscosity = viscosity;
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::compute_densities(unsigned begin, unsigned end)
+    {
+        const real self = kernel.value(0);
+        for (unsigned i = begin; i < end; i++)
+        {
+            const unsigned *j = neighbours.indices(i);
+            const real *distance = neighbours.distances(i);
+            const unsigned count = neighbours.count(i);
+
+            real density = masses[i] * self;
+            for (unsigned n = 0; n < count; n++)
+                density += masses[j[n]] * kernel.value(distance[n]);
+
+            densities[i] = density;
+            pressures[i] = (density - target_density) * stiffness;
+        }
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::compute_forces(ParticleStore &store, unsigned begin, unsigned end)
+    {
+        const real *px = store.position_x.data(), *py = store.position_y.data(), *pz = store.position_z.data();
+        const real *vx = store.velocity_x.data(), *vy = store.velocity_y.data(), *vz = store.velocity_z.data();
+
+        for (unsigned i = begin; i < end; i++)
+        {
+            if (masses[i] == 0 || densities[i] <= 0)
+                continue;
+
+            const unsigned *j = neighbours.indices(i);
+            const real *distance = neighbours.distances(i);
+            const unsigned count = neighbours.count(i);
+
+            // sums in Vector4 so simd builds add up a neighbour in one instruction per sum
+            const Vector4 position(Vector3(px[i], py[i], pz[i])), velocity(Vector3(vx[i], vy[i], vz[i]));
+            Vector4 pressure_force, viscosity_force;
+            for (unsigned n = 0; n < count; n++)
+            {
+                const unsigned other = j[n];
+                if (densities[other] <= 0)
+                    continue;
+
+                Vector4 direction;
+                if (distance[n] > 0)
+                    direction = (Vector4(Vector3(px[other], py[other], pz[other])) - position) * (1 / distance[n]);
+                else
+                    direction = Vector4(sph_coincident_direction(i, other));
+
+                // shared pressure keeps the pair's forces equal and opposite
+                real volume = masses[other] / densities[other];
+                real shared_pressure = (pressures[i] + pressures[other]) / 2;
+                pressure_force.add_scaled_vector(direction, shared_pressure * kernel.derivative(distance[n]) * volume);
+
+                Vector4 relative = Vector4(Vector3(vx[other], vy[other], vz[other])) - velocity;
+                viscosity_force.add_scaled_vector(relative, kernel.value(distance[n]) * volume);
+            }
+
+            // both sums are accelerations per unit density, turned into a force for the store's accumulator
+            Vector4 acceleration = pressure_force * (1 / densities[i]);
+            acceleration.add_scaled_vector(viscosity_force, viscosity);
+            store.add_force(i, (acceleration * masses[i]).to_vector3());
+        }
+    }
+
+    template <typename Kernel>
+    void SphFluid<Kernel>::apply(ParticleStore &store, JobPool *jobs)
+    {
+        const unsigned count = store.size();
+        masses.resize(count);
+        densities.resize(count);
+        pressures.resize(count);
+        for (unsigned i = 0; i < count; i++)
+            masses[i] = store.inverse_mass[i] > 0 ? 1 / store.inverse_mass[i] : 0;
+
+        neighbours.build(store, kernel.radius, jobs);
+
+        // the force pass reads every neighbour's density so the passes cant be fused
+        SphNeighbours::for_each_range(jobs, count, [this](unsigned begin, unsigned end, unsigned)
+                                      { compute_densities(begin, end); });
+        SphNeighbours::for_each_range(jobs, count, [this, &store](unsigned begin, unsigned end, unsigned)
+                                      { compute_forces(store, begin, end); });
+    }
+}
+
+#endif // !GABBYPHYSICS_PSPH_H
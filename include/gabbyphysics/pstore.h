@@ -0,0 +1,151 @@
+#ifndef GABBYPHYSICS_PSTORE_H
+#define GABBYPHYSICS_PSTORE_H
+
+#include "core.h"
+
+#include "vector"
+
+namespace gabbyphysics
+{
+    // where a ParticleStore's position and velocity arrays live, in a fixed layout for readers that cant call into c++
+    // e.g. js wrapping wasm linear memory in typed arrays, see ParticleStateView in the web examples' util.mts
+    // on wasm32 every field is 4 bytes, so the struct reads as 11 consecutive u32 words in declaration order
+    struct ParticleStoreLayout
+    {
+        // bumped when fields are added, moved or change meaning
+        const static unsigned VERSION = 1;
+
+        enum Precision
+        {
+            FLOAT = 0,
+            DOUBLE = 1,
+            // raw 32.32 integers, see fixed.h
+            FIXED = 2
+        };
+
+        unsigned version;
+        // element type of the real arrays, one of Precision
+        unsigned precision;
+        // changes whenever an array moves, count changes or slots are reordered, views made at another generation are stale
+        unsigned generation;
+        unsigned count;
+        const real *position_x;
+        const real *position_y;
+        const real *position_z;
+        const real *velocity_x;
+        const real *velocity_y;
+        const real *velocity_z;
+        // slot -> handle, to follow a particle across destroy and permute
+        const unsigned *handles;
+    };
+
+#if defined(__wasm32__)
+    static_assert(sizeof(ParticleStoreLayout) == 11 * 4, "js reads ParticleStoreLayout as 11 u32 words");
+#endif
+
+    // structure of arrays particle storage
+    // each component lives in its own contiguous array indexed by slot so integration and force passes stream linearly
+    // particles are referred to by a handle which stays valid until destroy even when slots get moved around
+    class ParticleStore
+    {
+    public:
+        // the low HANDLE_INDEX_BITS pick the entry in slots, the bits above count how many times that entry was reused
+        // so a handle kept past destroy doesnt pass is_valid or get_slot once a new particle takes the entry
+        typedef unsigned Handle;
+        const static Handle INVALID_HANDLE = 0xffffffff;
+        const static unsigned HANDLE_INDEX_BITS = 24;
+        const static unsigned HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+        // get_slot of a handle that isnt valid
+        const static unsigned INVALID_SLOT = 0xffffffff;
+
+        // per slot components, all of length size()
+        std::vector<real> position_x;
+        std::vector<real> position_y;
+        std::vector<real> position_z;
+        std::vector<real> velocity_x;
+        std::vector<real> velocity_y;
+        std::vector<real> velocity_z;
+        std::vector<real> acceleration_x;
+        std::vector<real> acceleration_y;
+        std::vector<real> acceleration_z;
+        std::vector<real> force_x;
+        std::vector<real> force_y;
+        std::vector<real> force_z;
+        std::vector<real> damping;
+        std::vector<real> inverse_mass;
+        // bit mask matched against ParticleForceField::mask
+        std::vector<unsigned> layers;
+
+    protected:
+        // handle index -> slot, INVALID_SLOT marks a free entry
+        std::vector<unsigned> slots;
+        // slot -> handle, generation included
+        std::vector<Handle> handles;
+        // handles of destroyed particles, create reuses their entry with the next generation
+        std::vector<Handle> free_handles;
+
+        // kept between sorts so a periodic sort_spatially doesnt allocate
+        std::vector<unsigned> sort_keys;
+        std::vector<unsigned> sort_order;
+        std::vector<unsigned> sort_scratch;
+        std::vector<real> permute_scratch;
+
+        ParticleStoreLayout layout;
+        // refreshes layout after anything that can move an array, reordered forces a new generation
+        void update_layout(bool reordered = false);
+
+    public:
+        ParticleStore();
+
+        // where default constructed Particles keep their state, one store per thread created on first use
+        // so threads that build their own particles or worlds never share arrays or handles
+        // it isnt locked: a particle owning a slot here is only copied from or destroyed on another thread
+        // while the thread that made it isnt creating or destroying standalone particles
+        static ParticleStore &get_standalone();
+
+        // new particles are at rest at the origin with damping 1, infinite mass and layer 1
+        // at most 2^HANDLE_INDEX_BITS - 1 particles can be alive at once
+        Handle create();
+        // moves the last slot into the freed one so the arrays stay dense
+        void destroy(Handle handle);
+        void reserve(unsigned capacity);
+        void clear();
+
+        unsigned size() const;
+        bool is_valid(Handle handle) const;
+        // INVALID_SLOT when handle isnt valid
+        unsigned get_slot(Handle handle) const;
+        Handle get_handle(unsigned slot) const;
+        // kept up to date by every call that can move the arrays, at the same address for the store's lifetime
+        // writing to the component vectors directly skips the update
+        const ParticleStoreLayout &get_layout() const;
+
+        // moves slot order[i] to slot i for every i, order must hold each slot once
+        // handles follow their particles so Particle views stay valid, slot indices kept anywhere else dont
+        void permute(const std::vector<unsigned> &order);
+        // radix sorts the slots by the morton code of the cell_size grid cell each particle is in
+        // particles near each other in space end up near each other in memory, which neighbour passes
+        // like SphFluid read much faster once particles have mixed
+        // cells count up from the origin, anything below it or past 1024 cells along an axis shares the edge cell
+        void sort_spatially(real cell_size);
+
+        Vector3 get_position(unsigned slot) const;
+        void set_position(unsigned slot, const Vector3 &position);
+        Vector3 get_velocity(unsigned slot) const;
+        void set_velocity(unsigned slot, const Vector3 &velocity);
+        Vector3 get_acceleration(unsigned slot) const;
+        void set_acceleration(unsigned slot, const Vector3 &acceleration);
+        void add_force(unsigned slot, const Vector3 &force);
+
+        // integrates the slots [begin, end), see Particle::integrate
+        void integrate(real duration, unsigned begin, unsigned end);
+        void integrate(real duration);
+        // same result as integrate but GABBYPHYSICS_SIMD_WIDTH slots per instruction
+        // pow(damping, duration) is computed once per batch when the batch shares a damping value
+        void integrate_batch(real duration, unsigned begin, unsigned end);
+        void integrate_batch(real duration);
+        void clear_accumulators();
+    };
+}
+
+#endif // !GABBYPHYSICS_PSTORE_H
@@ -1,7 +1,9 @@
 #ifndef GABBYPHYSICS_PWORLD_H
 #define GABBYPHYSICS_PWORLD_H
 
+#include "memory"
 #include "vector"
+#include "pjobs.h"
 #include "plinks.h"
 #include "pfgen.h"
 
@@ -12,29 +14,149 @@ namespace gabbyphysics
     public:
         typedef std::vector<gabbyphysics::Particle *> Particles;
         typedef std::vector<ParticleContactGenerator *> ContactGenerators;
+        typedef std::vector<ParticleForceField *> ForceFields;
+
+        enum ContactSolverType
+        {
+            // ParticleContactResolver, one contact per iteration
+            RESOLVER,
+            // ParticleContactSolver, fixed gauss-seidel sweeps over every contact
+            SEQUENTIAL_IMPULSE
+        };
+
+        // no per generator cap, each generator may fill as much of the arena as it needs
+        const static unsigned UNLIMITED = 0xffffffff;
+
+        struct ContactStats
+        {
+            // contacts the arena holds without growing
+            unsigned capacity;
+            // most contacts generated in one frame since the last reset
+            unsigned high_water;
+            // times the arena or a thread buffer grew
+            unsigned grows;
+            // generators rerun because they filled the room left before finishing
+            unsigned regenerated;
+            // generators that hit the per generator limit last frame, their remaining contacts were dropped
+            unsigned clipped;
+        };
 
     protected:
         Particles particles;
+        // optional soa storage, particles viewing it are integrated in one linear pass
+        ParticleStore store;
+        // start_frame sorts the store's slots by grid cell every reorder_interval frames, 0 never
+        unsigned reorder_interval;
+        real reorder_cell_size;
+        unsigned frames_since_reorder;
         bool calculate_iterations;
         ParticleForceRegistry registry;
+        // applied to every particle after the registry, without per particle registrations
+        ForceFields force_fields;
         ParticleContactResolver resolver;
+        ParticleContactSolver solver;
+        ContactSolverType solver_type;
         ContactGenerators contact_generators;
-        ParticleContact *contacts;
-        unsigned max_contacts;
+        // grows geometrically when a frame needs more and is never shrunk, so steady scenes stop allocating
+        std::vector<ParticleContact> contacts;
+        unsigned generator_contact_limit;
+        unsigned used_contacts;
+        ContactStats contact_stats;
+
+        // optional, splits forces, integration and contact generation across threads
+        std::unique_ptr<JobPool> jobs;
+
+        // one generator per thread, thread t's is the world seed jumped t times so the streams never overlap
+        unsigned long long random_seed;
+        std::vector<Random> randoms;
+        void seed_randoms();
+
+        // each thread generates into its own buffer, chunks are merged back in generator order
+        struct ContactSegment
+        {
+            unsigned thread;
+            unsigned offset;
+            unsigned count;
+        };
+        std::vector<std::vector<ParticleContact>> thread_contacts;
+        std::vector<unsigned> thread_contact_counts;
+        std::vector<ContactStats> thread_contact_stats;
+        std::vector<ContactSegment> contact_segments;
+
+        // what the iterative resolver runs on, generators write store slots into it instead of filling the arena
+        ParticleCompactContacts compact_contacts;
+        struct CompactSegment
+        {
+            unsigned thread;
+            ParticleCompactContacts::Mark begin;
+            ParticleCompactContacts::Mark end;
+        };
+        std::vector<ParticleCompactContacts> thread_compact_contacts;
+        std::vector<CompactSegment> compact_segments;
+
+        // runs generator into buffer from used onwards, growing buffer and rerunning the generator when it runs out of room
+        unsigned generate_into(std::vector<ParticleContact> &buffer, unsigned used, const ParticleContactGenerator *generator,
+                               ContactStats &stats) const;
+        unsigned generate_contacts_parallel();
+        // the table's columns grow as the generator writes, so unlike generate_into a generator only ever runs once
+        void generate_compact_into(ParticleCompactContacts &table, const ParticleContactGenerator *generator,
+                                   ContactStats &stats) const;
+        void generate_compact_contacts_parallel();
+        // runs job over [0, count) on the pool if there is one, otherwise in one go on this thread
+        void for_each_range(unsigned count, unsigned chunk_size, const JobPool::RangeJob &job);
 
     public:
-        // if no iterations provided then 2*max_contacts will be used
-        ParticleWorld(unsigned max_contacts, unsigned iterations = 0);
-        ~ParticleWorld();
+        // contacts is only the starting arena size, it grows to whatever the scene generates
+        // if no iterations provided then 2*contacts generated each frame will be used
+        ParticleWorld(unsigned contacts, unsigned iterations = 0);
 
+        // clears every accumulator, and sorts the store first when a reorder is due
         void start_frame();
         unsigned generate_contacts();
+        // the same contacts into a ParticleCompactContacts, what run_physics uses for the iterative resolver
+        // when it comes back mixed run_physics generates them again with generate_contacts
+        unsigned generate_compact_contacts();
+        // pushes every particle with every force field, store particles straight from the store's arrays
+        void apply_force_fields(real duration);
         void integrate(real duration);
+        // integrate with the store integrated by ParticleStore::integrate_batch, used by run_physics
+        void integrate_batch(real duration);
         void run_physics(real duration);
 
+        // 1 runs everything on the calling thread, 0 uses one thread per hardware thread
+        // also reseeds the world's generators, one per thread
+        void set_thread_count(unsigned threads);
+        unsigned get_thread_count() const;
+        JobPool *get_job_pool();
+
+        // reseeds every thread's generator, the same seed replays the same draws
+        void set_random_seed(unsigned long long seed);
+        // thread is the one a job was handed, 0 on the calling thread
+        Random &get_random(unsigned thread = 0);
+
         Particles &get_particles();
+        ParticleStore &get_particle_store();
+        // sorts the store with ParticleStore::sort_spatially every frames frames so neighbours stay close in memory as particles mix
+        // only store slots move, the particle list and anything indexed like it keep their order, 0 turns it off
+        void set_reorder_interval(unsigned frames, real cell_size);
+        unsigned get_reorder_interval() const;
         ContactGenerators &get_contact_generators();
         ParticleForceRegistry &get_force_registry();
+        ForceFields &get_force_fields();
+        ParticleContactResolver &get_contact_resolver();
+        ParticleContactSolver &get_contact_solver();
+        void set_contact_solver_type(ContactSolverType type);
+        ContactSolverType get_contact_solver_type() const;
+        // number of contacts generated by the last call to run_physics
+        unsigned get_contact_count() const;
+        // caps the contacts any one generator adds per frame, UNLIMITED by default
+        void set_generator_contact_limit(unsigned limit);
+        unsigned get_generator_contact_limit() const;
+        // grows the arena up front, e.g. to skip the first frames' growth
+        void reserve_contacts(unsigned capacity);
+        const ContactStats &get_contact_stats() const;
+        // clears the high water mark and counters, capacity is kept
+        void reset_contact_stats();
     };
 
     class GroundContacts : public gabbyphysics::ParticleContactGenerator
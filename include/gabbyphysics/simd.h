@@ -0,0 +1,312 @@
+#ifndef GABBYPHYSICS_SIMD_H
+#define GABBYPHYSICS_SIMD_H
+
+#include "core.h"
+
+// picks the widest instruction set the compiler was told it can use
+// AVX2 and SSE on native x86-64 builds, SIMD128 on wasm builds with -msimd128, scalar everywhere else
+// double builds use the same instruction sets with half the lanes, fixed point builds are always scalar
+#if defined(GABBYPHYSICS_FIXED_POINT)
+#define GABBYPHYSICS_SIMD_WIDTH 1
+#elif defined(__AVX2__)
+#include "immintrin.h"
+#define GABBYPHYSICS_SIMD_AVX2
+#define GABBYPHYSICS_SIMD_WIDTH (32 / sizeof(real))
+#elif defined(__SSE2__)
+#include "emmintrin.h"
+#define GABBYPHYSICS_SIMD_SSE
+#define GABBYPHYSICS_SIMD_WIDTH (16 / sizeof(real))
+#elif defined(__wasm_simd128__)
+#include "wasm_simd128.h"
+#define GABBYPHYSICS_SIMD_WASM
+#define GABBYPHYSICS_SIMD_WIDTH (16 / sizeof(real))
+#else
+#define GABBYPHYSICS_SIMD_WIDTH 1
+#endif
+
+// Vector4 only needs 4 float lanes, so arm builds get neon for it even though realv stays scalar there
+#if defined(GABBYPHYSICS_FIXED_POINT) || defined(GABBYPHYSICS_DOUBLE_PRECISION)
+#elif defined(__SSE2__)
+#define GABBYPHYSICS_VECTOR4_SSE
+#elif defined(__wasm_simd128__)
+#define GABBYPHYSICS_VECTOR4_WASM
+#elif defined(__ARM_NEON)
+#include "arm_neon.h"
+#define GABBYPHYSICS_VECTOR4_NEON
+#endif
+
+namespace gabbyphysics
+{
+    // GABBYPHYSICS_SIMD_WIDTH reals processed per instruction
+    // loads and stores are unaligned so any slot of a ParticleStore array can start a batch
+    // select_greater picks x in the lanes where a > b and y everywhere else
+    // gather loads base[indices[lane]] into each lane
+    // load_u16 converts the 16 bits of words[lane] starting at bit shift into each lane
+    struct realv
+    {
+#if defined(GABBYPHYSICS_SIMD_AVX2) && defined(GABBYPHYSICS_DOUBLE_PRECISION)
+        __m256d v;
+
+        static realv load(const real *p) { return {_mm256_loadu_pd(p)}; }
+        static realv broadcast(real r) { return {_mm256_set1_pd(r)}; }
+        // the masked form with a zeroed source, the unmasked one trips gcc's uninitialized warning
+        static realv gather(const real *base, const unsigned *indices)
+        {
+            __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            return {_mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm_loadu_si128((const __m128i *)indices), all, 8)};
+        }
+        static realv load_u16(const unsigned *words, unsigned shift)
+        {
+            __m128i w = _mm_srl_epi32(_mm_loadu_si128((const __m128i *)words), _mm_cvtsi32_si128(shift));
+            return {_mm256_cvtepi32_pd(_mm_and_si128(w, _mm_set1_epi32(0xffff)))};
+        }
+        void store(real *p) const { _mm256_storeu_pd(p, v); }
+        realv operator+(const realv &o) const { return {_mm256_add_pd(v, o.v)}; }
+        realv operator*(const realv &o) const { return {_mm256_mul_pd(v, o.v)}; }
+        realv operator-(const realv &o) const { return {_mm256_sub_pd(v, o.v)}; }
+        realv operator/(const realv &o) const { return {_mm256_div_pd(v, o.v)}; }
+        realv sqrt() const { return {_mm256_sqrt_pd(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y) { return {_mm256_blendv_pd(y.v, x.v, _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ))}; }
+        bool equals(real r) const { return _mm256_movemask_pd(_mm256_cmp_pd(v, _mm256_set1_pd(r), _CMP_EQ_OQ)) == 0xf; }
+#elif defined(GABBYPHYSICS_SIMD_AVX2)
+        __m256 v;
+
+        static realv load(const real *p) { return {_mm256_loadu_ps(p)}; }
+        static realv broadcast(real r) { return {_mm256_set1_ps(r)}; }
+        static realv gather(const real *base, const unsigned *indices) { return {_mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i *)indices), 4)}; }
+        static realv load_u16(const unsigned *words, unsigned shift)
+        {
+            __m256i w = _mm256_srl_epi32(_mm256_loadu_si256((const __m256i *)words), _mm_cvtsi32_si128(shift));
+            return {_mm256_cvtepi32_ps(_mm256_and_si256(w, _mm256_set1_epi32(0xffff)))};
+        }
+        void store(real *p) const { _mm256_storeu_ps(p, v); }
+        realv operator+(const realv &o) const { return {_mm256_add_ps(v, o.v)}; }
+        realv operator*(const realv &o) const { return {_mm256_mul_ps(v, o.v)}; }
+        realv operator-(const realv &o) const { return {_mm256_sub_ps(v, o.v)}; }
+        realv operator/(const realv &o) const { return {_mm256_div_ps(v, o.v)}; }
+        realv sqrt() const { return {_mm256_sqrt_ps(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y) { return {_mm256_blendv_ps(y.v, x.v, _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ))}; }
+        bool equals(real r) const { return _mm256_movemask_ps(_mm256_cmp_ps(v, _mm256_set1_ps(r), _CMP_EQ_OQ)) == 0xff; }
+#elif defined(GABBYPHYSICS_SIMD_SSE) && defined(GABBYPHYSICS_DOUBLE_PRECISION)
+        __m128d v;
+
+        static realv load(const real *p) { return {_mm_loadu_pd(p)}; }
+        static realv broadcast(real r) { return {_mm_set1_pd(r)}; }
+        static realv gather(const real *base, const unsigned *indices) { return {_mm_setr_pd(base[indices[0]], base[indices[1]])}; }
+        static realv load_u16(const unsigned *words, unsigned shift)
+        {
+            __m128i w = _mm_srl_epi32(_mm_loadl_epi64((const __m128i *)words), _mm_cvtsi32_si128(shift));
+            return {_mm_cvtepi32_pd(_mm_and_si128(w, _mm_set1_epi32(0xffff)))};
+        }
+        void store(real *p) const { _mm_storeu_pd(p, v); }
+        realv operator+(const realv &o) const { return {_mm_add_pd(v, o.v)}; }
+        realv operator*(const realv &o) const { return {_mm_mul_pd(v, o.v)}; }
+        realv operator-(const realv &o) const { return {_mm_sub_pd(v, o.v)}; }
+        realv operator/(const realv &o) const { return {_mm_div_pd(v, o.v)}; }
+        realv sqrt() const { return {_mm_sqrt_pd(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y)
+        {
+            __m128d mask = _mm_cmpgt_pd(a.v, b.v);
+            return {_mm_or_pd(_mm_and_pd(mask, x.v), _mm_andnot_pd(mask, y.v))};
+        }
+        bool equals(real r) const { return _mm_movemask_pd(_mm_cmpeq_pd(v, _mm_set1_pd(r))) == 0x3; }
+#elif defined(GABBYPHYSICS_SIMD_SSE)
+        __m128 v;
+
+        static realv load(const real *p) { return {_mm_loadu_ps(p)}; }
+        static realv broadcast(real r) { return {_mm_set1_ps(r)}; }
+        static realv gather(const real *base, const unsigned *indices) { return {_mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]])}; }
+        static realv load_u16(const unsigned *words, unsigned shift)
+        {
+            __m128i w = _mm_srl_epi32(_mm_loadu_si128((const __m128i *)words), _mm_cvtsi32_si128(shift));
+            return {_mm_cvtepi32_ps(_mm_and_si128(w, _mm_set1_epi32(0xffff)))};
+        }
+        void store(real *p) const { _mm_storeu_ps(p, v); }
+        realv operator+(const realv &o) const { return {_mm_add_ps(v, o.v)}; }
+        realv operator*(const realv &o) const { return {_mm_mul_ps(v, o.v)}; }
+        realv operator-(const realv &o) const { return {_mm_sub_ps(v, o.v)}; }
+        realv operator/(const realv &o) const { return {_mm_div_ps(v, o.v)}; }
+        realv sqrt() const { return {_mm_sqrt_ps(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y)
+        {
+            __m128 mask = _mm_cmpgt_ps(a.v, b.v);
+            return {_mm_or_ps(_mm_and_ps(mask, x.v), _mm_andnot_ps(mask, y.v))};
+        }
+        bool equals(real r) const { return _mm_movemask_ps(_mm_cmpeq_ps(v, _mm_set1_ps(r))) == 0xf; }
+#elif defined(GABBYPHYSICS_SIMD_WASM) && defined(GABBYPHYSICS_DOUBLE_PRECISION)
+        v128_t v;
+
+        static realv load(const real *p) { return {wasm_v128_load(p)}; }
+        static realv broadcast(real r) { return {wasm_f64x2_splat(r)}; }
+        static realv gather(const real *base, const unsigned *indices) { return {wasm_f64x2_make(base[indices[0]], base[indices[1]])}; }
+        static realv load_u16(const unsigned *words, unsigned shift)
+        {
+            v128_t w = wasm_u32x4_shr(wasm_v128_load64_zero(words), shift);
+            return {wasm_f64x2_convert_low_i32x4(wasm_v128_and(w, wasm_i32x4_splat(0xffff)))};
+        }
+        void store(real *p) const { wasm_v128_store(p, v); }
+        realv operator+(const realv &o) const { return {wasm_f64x2_add(v, o.v)}; }
+        realv operator*(const realv &o) const { return {wasm_f64x2_mul(v, o.v)}; }
+        realv operator-(const realv &o) const { return {wasm_f64x2_sub(v, o.v)}; }
+        realv operator/(const realv &o) const { return {wasm_f64x2_div(v, o.v)}; }
+        realv sqrt() const { return {wasm_f64x2_sqrt(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y) { return {wasm_v128_bitselect(x.v, y.v, wasm_f64x2_gt(a.v, b.v))}; }
+        bool equals(real r) const { return wasm_i64x2_all_true(wasm_f64x2_eq(v, wasm_f64x2_splat(r))); }
+#elif defined(GABBYPHYSICS_SIMD_WASM)
+        v128_t v;
+
+        static realv load(const real *p) { return {wasm_v128_load(p)}; }
+        static realv broadcast(real r) { return {wasm_f32x4_splat(r)}; }
+        static realv gather(const real *base, const unsigned *indices) { return {wasm_f32x4_make(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]])}; }
+        static realv load_u16(const unsigned *words, unsigned shift)
+        {
+            v128_t w = wasm_u32x4_shr(wasm_v128_load(words), shift);
+            return {wasm_f32x4_convert_i32x4(wasm_v128_and(w, wasm_i32x4_splat(0xffff)))};
+        }
+        void store(real *p) const { wasm_v128_store(p, v); }
+        realv operator+(const realv &o) const { return {wasm_f32x4_add(v, o.v)}; }
+        realv operator*(const realv &o) const { return {wasm_f32x4_mul(v, o.v)}; }
+        realv operator-(const realv &o) const { return {wasm_f32x4_sub(v, o.v)}; }
+        realv operator/(const realv &o) const { return {wasm_f32x4_div(v, o.v)}; }
+        realv sqrt() const { return {wasm_f32x4_sqrt(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y) { return {wasm_v128_bitselect(x.v, y.v, wasm_f32x4_gt(a.v, b.v))}; }
+        bool equals(real r) const { return wasm_i32x4_all_true(wasm_f32x4_eq(v, wasm_f32x4_splat(r))); }
+#else
+        real v;
+
+        static realv load(const real *p) { return {*p}; }
+        static realv broadcast(real r) { return {r}; }
+        static realv gather(const real *base, const unsigned *indices) { return {base[*indices]}; }
+        static realv load_u16(const unsigned *words, unsigned shift) { return {real(int((*words >> shift) & 0xffff))}; }
+        void store(real *p) const { *p = v; }
+        realv operator+(const realv &o) const { return {v + o.v}; }
+        realv operator*(const realv &o) const { return {v * o.v}; }
+        realv operator-(const realv &o) const { return {v - o.v}; }
+        realv operator/(const realv &o) const { return {v / o.v}; }
+        realv sqrt() const { return {real_sqrt(v)}; }
+        static realv select_greater(const realv &a, const realv &b, const realv &x, const realv &y) { return {a.v > b.v ? x.v : y.v}; }
+        bool equals(real r) const { return v == r; }
+#endif
+    };
+
+    // a Vector3 in one 16 byte register with a zero w lane, for vector math on single particles
+    // Vector3 stays the storage type, convert in, do the math and convert back out
+    class Vector4
+    {
+    public:
+#if defined(GABBYPHYSICS_VECTOR4_SSE)
+        __m128 v;
+
+        Vector4() : v(_mm_setzero_ps()) {}
+        Vector4(__m128 v) : v(v) {}
+        // the set doesnt read past z, so packed Vector3s at the end of an allocation are safe
+        Vector4(const Vector3 &vector) : v(_mm_setr_ps(vector.x, vector.y, vector.z, 0)) {}
+        static Vector4 broadcast(real r) { return Vector4(_mm_set1_ps(r)); }
+
+        Vector4 operator+(const Vector4 &o) const { return Vector4(_mm_add_ps(v, o.v)); }
+        Vector4 operator-(const Vector4 &o) const { return Vector4(_mm_sub_ps(v, o.v)); }
+        Vector4 operator*(real value) const { return Vector4(_mm_mul_ps(v, _mm_set1_ps(value))); }
+        Vector4 component_product(const Vector4 &o) const { return Vector4(_mm_mul_ps(v, o.v)); }
+        void store(real *p) const { _mm_storeu_ps(p, v); }
+#elif defined(GABBYPHYSICS_VECTOR4_WASM)
+        v128_t v;
+
+        Vector4() : v(wasm_f32x4_splat(0)) {}
+        Vector4(v128_t v) : v(v) {}
+        Vector4(const Vector3 &vector) : v(wasm_f32x4_make(vector.x, vector.y, vector.z, 0)) {}
+        static Vector4 broadcast(real r) { return Vector4(wasm_f32x4_splat(r)); }
+
+        Vector4 operator+(const Vector4 &o) const { return Vector4(wasm_f32x4_add(v, o.v)); }
+        Vector4 operator-(const Vector4 &o) const { return Vector4(wasm_f32x4_sub(v, o.v)); }
+        Vector4 operator*(real value) const { return Vector4(wasm_f32x4_mul(v, wasm_f32x4_splat(value))); }
+        Vector4 component_product(const Vector4 &o) const { return Vector4(wasm_f32x4_mul(v, o.v)); }
+        void store(real *p) const { wasm_v128_store(p, v); }
+#elif defined(GABBYPHYSICS_VECTOR4_NEON)
+        float32x4_t v;
+
+        Vector4() : v(vdupq_n_f32(0)) {}
+        Vector4(float32x4_t v) : v(v) {}
+        Vector4(const Vector3 &vector)
+        {
+            real lanes[4] = {vector.x, vector.y, vector.z, 0};
+            v = vld1q_f32(lanes);
+        }
+        static Vector4 broadcast(real r) { return Vector4(vdupq_n_f32(r)); }
+
+        Vector4 operator+(const Vector4 &o) const { return Vector4(vaddq_f32(v, o.v)); }
+        Vector4 operator-(const Vector4 &o) const { return Vector4(vsubq_f32(v, o.v)); }
+        Vector4 operator*(real value) const { return Vector4(vmulq_n_f32(v, value)); }
+        Vector4 component_product(const Vector4 &o) const { return Vector4(vmulq_f32(v, o.v)); }
+        void store(real *p) const { vst1q_f32(p, v); }
+#else
+        real v[4];
+
+        Vector4() : v{0, 0, 0, 0} {}
+        Vector4(const Vector3 &vector) : v{vector.x, vector.y, vector.z, 0} {}
+        static Vector4 broadcast(real r)
+        {
+            Vector4 result;
+            result.v[0] = result.v[1] = result.v[2] = result.v[3] = r;
+            return result;
+        }
+
+        Vector4 operator+(const Vector4 &o) const
+        {
+            Vector4 result;
+            for (unsigned i = 0; i < 4; i++)
+                result.v[i] = v[i] + o.v[i];
+            return result;
+        }
+        Vector4 operator-(const Vector4 &o) const
+        {
+            Vector4 result;
+            for (unsigned i = 0; i < 4; i++)
+                result.v[i] = v[i] - o.v[i];
+            return result;
+        }
+        Vector4 operator*(real value) const
+        {
+            Vector4 result;
+            for (unsigned i = 0; i < 4; i++)
+                result.v[i] = v[i] * value;
+            return result;
+        }
+        Vector4 component_product(const Vector4 &o) const
+        {
+            Vector4 result;
+            for (unsigned i = 0; i < 4; i++)
+                result.v[i] = v[i] * o.v[i];
+            return result;
+        }
+        void store(real *p) const
+        {
+            for (unsigned i = 0; i < 4; i++)
+                p[i] = v[i];
+        }
+#endif
+
+        void operator+=(const Vector4 &o) { *this = *this + o; }
+        void operator-=(const Vector4 &o) { *this = *this - o; }
+        void operator*=(real value) { *this = *this * value; }
+        void add_scaled_vector(const Vector4 &vector, real scale) { *this = *this + vector * scale; }
+
+        // dot product, w is zero on both sides for anything built from a Vector3
+        real operator*(const Vector4 &o) const
+        {
+            real lanes[4];
+            component_product(o).store(lanes);
+            return lanes[0] + lanes[1] + lanes[2];
+        }
+        real sqare_magnitude() const { return *this * *this; }
+        real magnitude() const { return real_sqrt(sqare_magnitude()); }
+
+        Vector3 to_vector3() const
+        {
+            real lanes[4];
+            store(lanes);
+            return Vector3(lanes[0], lanes[1], lanes[2]);
+        }
+    };
+}
+
+#endif // !GABBYPHYSICS_SIMD_H
@@ -1,4 +1,7 @@
 #include "gabbyphysics/core.h"
+#include "gabbyphysics/simd.h"
+
+#include "random"
 
 using namespace gabbyphysics;
 
@@ -10,3 +13,158 @@ const Vector3 Vector3::RIGHT = Vector3(1, 0, 0);
 const Vector3 Vector3::X = Vector3(0, 1, 0);
 const Vector3 Vector3::Y = Vector3(1, 0, 0);
 const Vector3 Vector3::Z = Vector3(0, 0, 1);
+
+Vector3 Vector3::get_random()
+{
+    thread_local Random random(std::random_device{}());
+    return get_random(random);
+}
+
+Vector3 Vector3::get_random(Random &random)
+{
+    Vector3 vec = Vector3(random.unit(), random.unit(), random.unit());
+    vec.normalize();
+    return vec;
+}
+
+Random::Random(unsigned long long seed)
+{
+    Random::seed(seed);
+}
+
+void Random::seed(unsigned long long seed)
+{
+    // splitmix64, so nearby seeds still give unrelated states and the state is never all zero
+    for (unsigned i = 0; i < 4; i++)
+    {
+        unsigned long long z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        state[i] = z ^ (z >> 31);
+    }
+}
+
+static inline unsigned long long rotate_left(unsigned long long x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+unsigned long long Random::next()
+{
+    const unsigned long long result = rotate_left(state[1] * 5, 7) * 9;
+    const unsigned long long t = state[1] << 17;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotate_left(state[3], 45);
+
+    return result;
+}
+
+void Random::jump()
+{
+    static const unsigned long long JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+
+    unsigned long long jumped[4] = {0, 0, 0, 0};
+    for (unsigned i = 0; i < 4; i++)
+    {
+        for (int b = 0; b < 64; b++)
+        {
+            if (JUMP[i] & (1ull << b))
+            {
+                for (unsigned s = 0; s < 4; s++)
+                    jumped[s] ^= state[s];
+            }
+            next();
+        }
+    }
+
+    for (unsigned s = 0; s < 4; s++)
+        state[s] = jumped[s];
+}
+
+real Random::unit()
+{
+    // only as many bits as real holds, so rounding can never reach 1
+#if defined(GABBYPHYSICS_FIXED_POINT)
+    return fixed::from_raw(fixed::raw_type(next() >> (64 - fixed::FRACTION_BITS)));
+#elif defined(GABBYPHYSICS_DOUBLE_PRECISION)
+    return real(next() >> 11) * real(0x1.0p-53);
+#else
+    return real(next() >> 40) * real(0x1.0p-24);
+#endif
+}
+
+real Random::range(real min, real max)
+{
+    return min + (max - min) * unit();
+}
+
+Vector3 Random::unit_vector()
+{
+    // rejection sample the unit ball, about half the draws land inside, then push out to the surface
+    for (;;)
+    {
+        // one at a time so a seed gives the same vectors whatever order a compiler evaluates arguments in
+        real x = range(-1, 1);
+        real y = range(-1, 1);
+        real z = range(-1, 1);
+        Vector3 vec(x, y, z);
+        real square = vec.sqare_magnitude();
+        if (square <= 1 && square > real(1e-6f))
+        {
+            vec *= 1 / real_sqrt(square);
+            return vec;
+        }
+    }
+}
+
+void Random::unit_vectors(Vector3 *out, unsigned count)
+{
+    // candidates are drawn a block at a time, scored and normalized in simd over the whole block, then the ones inside
+    // the ball are kept in draw order
+    const unsigned BLOCK = 64;
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    real x[BLOCK], y[BLOCK], z[BLOCK], square[BLOCK], scale[BLOCK];
+
+    const realv one = realv::broadcast(1), two = realv::broadcast(2), minus_one = realv::broadcast(-1);
+
+    unsigned done = 0;
+    while (done < count)
+    {
+        // about half the candidates land inside, so draw twice what is still missing
+        unsigned wanted = (count - done) * 2;
+        unsigned block = wanted < BLOCK ? (wanted + width - 1) / width * width : BLOCK;
+
+        for (unsigned i = 0; i < block; i++)
+        {
+            x[i] = unit();
+            y[i] = unit();
+            z[i] = unit();
+        }
+
+        for (unsigned i = 0; i < block; i += width)
+        {
+            realv vx = minus_one + two * realv::load(x + i);
+            realv vy = minus_one + two * realv::load(y + i);
+            realv vz = minus_one + two * realv::load(z + i);
+            vx.store(x + i);
+            vy.store(y + i);
+            vz.store(z + i);
+
+            realv s = vx * vx + vy * vy + vz * vz;
+            s.store(square + i);
+            // lanes outside the ball are thrown away below, including any 1 / 0
+            (one / s.sqrt()).store(scale + i);
+        }
+
+        for (unsigned i = 0; i < block && done < count; i++)
+        {
+            if (square[i] <= 1 && square[i] > real(1e-6f))
+                out[done++] = Vector3(x[i] * scale[i], y[i] * scale[i], z[i] * scale[i]);
+        }
+    }
+}
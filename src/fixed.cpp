@@ -0,0 +1,125 @@
+#include "gabbyphysics/fixed.h"
+
+using namespace gabbyphysics;
+
+typedef fixed::raw_type raw_type;
+typedef unsigned __int128 wide;
+
+// digit by digit square root of a 128 bit integer
+static wide isqrt(wide n)
+{
+    wide result = 0;
+    wide bit = wide(1) << 126;
+    while (bit > n)
+        bit >>= 2;
+
+    while (bit != 0)
+    {
+        if (n >= result + bit)
+        {
+            n -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+            result >>= 1;
+        bit >>= 2;
+    }
+    return result;
+}
+
+fixed gabbyphysics::fixed_sqrt(fixed value)
+{
+    if (value.raw <= 0)
+        return fixed();
+    return fixed::from_raw(raw_type(isqrt(wide(value.raw) << fixed::FRACTION_BITS)));
+}
+
+// log2 of a positive value, one fraction bit per squaring of the mantissa
+static raw_type log2_raw(raw_type value)
+{
+    const int msb = 63 - __builtin_clzll((unsigned long long)value);
+    raw_type result = raw_type(msb - fixed::FRACTION_BITS) * fixed::ONE;
+
+    // mantissa in [1, 2)
+    wide mantissa = wide(value);
+    if (msb > fixed::FRACTION_BITS)
+        mantissa >>= msb - fixed::FRACTION_BITS;
+    else
+        mantissa <<= fixed::FRACTION_BITS - msb;
+
+    for (int bit = 1; bit <= fixed::FRACTION_BITS; bit++)
+    {
+        mantissa = (mantissa * mantissa) >> fixed::FRACTION_BITS;
+        if (mantissa >= wide(2) * fixed::ONE)
+        {
+            mantissa >>= 1;
+            result += fixed::ONE >> bit;
+        }
+    }
+    return result;
+}
+
+// 2^value, the fraction bits multiply in 2^(2^-bit), which are repeated square roots of 2 so the table is exact integer math too
+static raw_type exp2_raw(raw_type value)
+{
+    struct Roots
+    {
+        raw_type root[fixed::FRACTION_BITS + 1];
+
+        Roots()
+        {
+            root[0] = 2 * fixed::ONE;
+            for (int bit = 1; bit <= fixed::FRACTION_BITS; bit++)
+                root[bit] = fixed_sqrt(fixed::from_raw(root[bit - 1])).raw;
+        }
+    };
+    static const Roots roots;
+
+    const raw_type whole = value >> fixed::FRACTION_BITS;
+    const raw_type fraction = value & (fixed::ONE - 1);
+
+    wide result = fixed::ONE;
+    for (int bit = 1; bit <= fixed::FRACTION_BITS; bit++)
+    {
+        if (fraction & (fixed::ONE >> bit))
+            result = (result * wide(roots.root[bit])) >> fixed::FRACTION_BITS;
+    }
+
+    if (whole >= 0)
+    {
+        // past the top of the range
+        if (whole >= 63 - fixed::FRACTION_BITS)
+            return LLONG_MAX;
+        return raw_type(result << whole);
+    }
+    if (whole <= -64)
+        return 0;
+    return raw_type(result >> -whole);
+}
+
+fixed gabbyphysics::fixed_pow(fixed value, fixed exponent)
+{
+    if (exponent.raw == 0)
+        return fixed(1);
+    if (value.raw <= 0)
+        return fixed();
+    return fixed::from_raw(exp2_raw((exponent * fixed::from_raw(log2_raw(value.raw))).raw));
+}
+
+fixed gabbyphysics::fixed_abs(fixed value)
+{
+    return value.raw < 0 ? -value : value;
+}
+
+fixed gabbyphysics::fixed_fmod(fixed value, fixed divisor)
+{
+    if (divisor.raw == 0)
+        return fixed();
+    return fixed::from_raw(value.raw % divisor.raw);
+}
+
+fixed gabbyphysics::fixed_floor(fixed value)
+{
+    // masking the fraction of a two's complement value rounds toward -infinity
+    return fixed::from_raw(value.raw & ~(fixed::ONE - 1));
+}
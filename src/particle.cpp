@@ -1,94 +1,166 @@
 #include "gabbyphysics/particle.h"
 
+#include "utility"
+
 using namespace gabbyphysics;
 
-// moves the particle forward in time using newton's method
-void Particle::integrate(real duration)
+// copies every component of from_slot in from into to_slot in to
+static void copy_slot(const ParticleStore &from, unsigned from_slot, ParticleStore &to, unsigned to_slot)
 {
-    if (duration == 0.0)
+    to.set_position(to_slot, from.get_position(from_slot));
+    to.set_velocity(to_slot, from.get_velocity(from_slot));
+    to.set_acceleration(to_slot, from.get_acceleration(from_slot));
+    to.force_x[to_slot] = from.force_x[from_slot];
+    to.force_y[to_slot] = from.force_y[from_slot];
+    to.force_z[to_slot] = from.force_z[from_slot];
+    to.damping[to_slot] = from.damping[from_slot];
+    to.inverse_mass[to_slot] = from.inverse_mass[from_slot];
+    to.layers[to_slot] = from.layers[from_slot];
+}
+
+Particle::Particle() : store(&ParticleStore::get_standalone()), handle(store->create()), owner(true) {}
+
+Particle::Particle(ParticleStore *store, ParticleStore::Handle handle) : store(store), handle(handle), owner(false) {}
+
+Particle::Particle(const Particle &other) : store(other.store), handle(other.handle), owner(other.owner)
+{
+    if (!owner)
         return;
 
-    position.add_scaled_vector(velocity, duration);
+    // create can grow the arrays so the source slot is looked up after it
+    store = &ParticleStore::get_standalone();
+    handle = store->create();
+    copy_slot(*other.store, other.store->get_slot(other.handle), *store, store->get_slot(handle));
+}
+
+Particle::Particle(Particle &&other) noexcept : store(other.store), handle(other.handle), owner(other.owner)
+{
+    other.owner = false;
+}
+
+Particle &Particle::operator=(const Particle &other)
+{
+    if (this == &other)
+        return *this;
+
+    // an owner keeps its slot, wherever it is, and just takes the other particle's state
+    if (owner && other.owner)
+    {
+        copy_slot(*other.store, other.store->get_slot(other.handle), *store, store->get_slot(handle));
+        return *this;
+    }
+
+    release();
+    store = other.store;
+    handle = other.handle;
+    owner = other.owner;
+    if (owner)
+    {
+        store = &ParticleStore::get_standalone();
+        handle = store->create();
+        copy_slot(*other.store, other.store->get_slot(other.handle), *store, store->get_slot(handle));
+    }
+    return *this;
+}
+
+Particle &Particle::operator=(Particle &&other) noexcept
+{
+    std::swap(store, other.store);
+    std::swap(handle, other.handle);
+    std::swap(owner, other.owner);
+    return *this;
+}
 
-    Vector3 resulting_accel = acceleration;
-    resulting_accel.add_scaled_vector(force_accum, inverse_mass);
+Particle::~Particle()
+{
+    release();
+}
 
-    velocity.add_scaled_vector(resulting_accel, duration);
+void Particle::release()
+{
+    if (owner)
+        store->destroy(handle);
+    owner = false;
+}
 
-    velocity *= real_pow(damping, duration);
+// moves the particle forward in time using newton's method
+void Particle::integrate(real duration)
+{
+    if (duration == 0.0)
+        return;
 
-    clear_accumulator();
+    unsigned slot = store->get_slot(handle);
+    store->integrate(duration, slot, slot + 1);
 }
 
 void Particle::set_position(const Vector3 &position)
 {
-    Particle::position = position;
+    store->set_position(store->get_slot(handle), position);
 }
 
 void Particle::set_position(const real x, const real y, const real z)
 {
-    Particle::position = Vector3(x, y, z);
+    set_position(Vector3(x, y, z));
 }
 
 Vector3 Particle::get_position() const
 {
-    return position;
+    return store->get_position(store->get_slot(handle));
 }
 
 void Particle::get_position(Vector3 *vec) const
 {
-    *vec = position;
+    *vec = get_position();
 }
 
 void Particle::set_velocity(const Vector3 &velocity)
 {
-    Particle::velocity = velocity;
+    store->set_velocity(store->get_slot(handle), velocity);
 }
 
 void Particle::set_velocity(const real x, const real y, const real z)
 {
-    velocity.x = x;
-    velocity.y = y;
-    velocity.z = z;
+    set_velocity(Vector3(x, y, z));
 }
 
 Vector3 Particle::get_velocity() const
 {
-    return velocity;
+    return store->get_velocity(store->get_slot(handle));
 }
 
 void Particle::get_velocity(Vector3 *vec) const
 {
-    *vec = velocity;
+    *vec = get_velocity();
 }
 
 void Particle::set_acceleration(const Vector3 &acceleration)
 {
-    Particle::acceleration = acceleration;
+    store->set_acceleration(store->get_slot(handle), acceleration);
 }
 
 Vector3 Particle::get_acceleration() const
 {
-    return acceleration;
+    return store->get_acceleration(store->get_slot(handle));
 }
 
 void Particle::set_damping(const real damping)
 {
-    Particle::damping = damping;
+    store->damping[store->get_slot(handle)] = damping;
 }
 
 real Particle::get_damping() const
 {
-    return damping;
+    return store->damping[store->get_slot(handle)];
 }
 
 void Particle::set_mass(const real mass)
 {
-    Particle::inverse_mass = ((real)1.0) / mass;
+    set_inverse_mass(((real)1.0) / mass);
 }
 
 real Particle::get_mass() const
 {
+    real inverse_mass = get_inverse_mass();
     if (inverse_mass == 0)
         return REAL_MAX;
     else
@@ -97,25 +169,36 @@ real Particle::get_mass() const
 
 void Particle::set_inverse_mass(const real inverse_mass)
 {
-    Particle::inverse_mass = inverse_mass;
+    store->inverse_mass[store->get_slot(handle)] = inverse_mass;
 }
 
 real Particle::get_inverse_mass() const
 {
-    return inverse_mass;
+    return store->inverse_mass[store->get_slot(handle)];
+}
+
+void Particle::set_layers(unsigned layers)
+{
+    store->layers[store->get_slot(handle)] = layers;
+}
+
+unsigned Particle::get_layers() const
+{
+    return store->layers[store->get_slot(handle)];
 }
 
 bool Particle::has_finite_mass() const
 {
-    return inverse_mass != 0;
+    return get_inverse_mass() != 0;
 }
 
 void Particle::clear_accumulator()
 {
-    force_accum.clear();
+    unsigned slot = store->get_slot(handle);
+    store->force_x[slot] = store->force_y[slot] = store->force_z[slot] = 0;
 }
 
 void Particle::add_force(const Vector3 &force)
 {
-    force_accum += force;
+    store->add_force(store->get_slot(handle), force);
 }
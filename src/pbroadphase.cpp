@@ -0,0 +1,777 @@
+#include "gabbyphysics/pbroadphase.h"
+
+#include "cmath"
+
+using namespace gabbyphysics;
+
+ParticleSpatialHash::ParticleSpatialHash(real cell_size) : table_mask(0)
+{
+    set_cell_size(cell_size);
+    bucket_start.assign(2, 0);
+}
+
+void ParticleSpatialHash::set_cell_size(real cell_size)
+{
+    ParticleSpatialHash::cell_size = cell_size;
+    inverse_cell_size = ((real)1.0) / cell_size;
+}
+
+real ParticleSpatialHash::get_cell_size() const
+{
+    return cell_size;
+}
+
+int ParticleSpatialHash::cell_coord(real value) const
+{
+    // nan compares false both ways
+    real cell = real_floor(value * inverse_cell_size);
+    if (cell > real(MAX_CELL))
+        return MAX_CELL;
+    if (cell < real(-MAX_CELL))
+        return -MAX_CELL;
+    if (!(cell == cell))
+        return 0;
+    return (int)cell;
+}
+
+unsigned ParticleSpatialHash::bucket(int cell_x, int cell_y, int cell_z) const
+{
+    unsigned hash = (unsigned)cell_x * 92837111u ^ (unsigned)cell_y * 689287499u ^ (unsigned)cell_z * 283923481u;
+    return hash & table_mask;
+}
+
+void ParticleSpatialHash::build(const real *x, const real *y, const real *z, unsigned count)
+{
+    unsigned table_size = 16;
+    while (table_size < count * 2)
+        table_size *= 2;
+    table_mask = table_size - 1;
+
+    point_buckets.resize(count);
+    bucket_start.assign(table_size + 1, 0);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned b = bucket(cell_coord(x[i]), cell_coord(y[i]), cell_coord(z[i]));
+        point_buckets[i] = b;
+        bucket_start[b + 1]++;
+    }
+
+    for (unsigned b = 0; b < table_size; b++)
+        bucket_start[b + 1] += bucket_start[b];
+
+    // scatter back to front, each end walks down to its bucket's start and points keep index order
+    entries.resize(count);
+    for (unsigned i = count; i-- > 0;)
+        entries[--bucket_start[point_buckets[i] + 1]] = i;
+
+    // bucket_start[b + 1] now holds bucket b's start, shift everything down one
+    for (unsigned b = 0; b < table_size; b++)
+        bucket_start[b] = bucket_start[b + 1];
+    bucket_start[table_size] = count;
+}
+
+unsigned ParticleSpatialHash::neighbour_buckets(real x, real y, real z, unsigned out[27]) const
+{
+    int cx = cell_coord(x), cy = cell_coord(y), cz = cell_coord(z);
+
+    unsigned count = 0;
+    for (int i = -1; i <= 1; i++)
+        for (int j = -1; j <= 1; j++)
+            for (int k = -1; k <= 1; k++)
+            {
+                unsigned b = bucket(cx + i, cy + j, cz + k);
+
+                bool seen = false;
+                for (unsigned n = 0; n < count && !seen; n++)
+                    seen = out[n] == b;
+                if (!seen)
+                    out[count++] = b;
+            }
+    return count;
+}
+
+ParticleSweepAndPrune::ParticleSweepAndPrune() : sweep_axis(0)
+{
+}
+
+void ParticleSweepAndPrune::sort_axis(unsigned axis)
+{
+    std::vector<Endpoint> &list = endpoints[axis];
+    const std::vector<real> &min = box_min[axis];
+    const std::vector<real> &max = box_max[axis];
+
+    for (std::vector<Endpoint>::iterator e = list.begin(); e != list.end(); e++)
+        e->value = (e->id & 1) ? max[e->id >> 1] : min[e->id >> 1];
+
+    // insertion sort, each endpoint only moves past the ones it crossed since last frame
+    for (unsigned i = 1; i < list.size(); i++)
+    {
+        Endpoint endpoint = list[i];
+        unsigned j = i;
+        for (; j > 0 && list[j - 1].value > endpoint.value; j--)
+            list[j] = list[j - 1];
+        list[j] = endpoint;
+    }
+}
+
+unsigned ParticleSweepAndPrune::choose_axis(const real *x, const real *y, const real *z, unsigned count) const
+{
+    const real *axes[3] = {x, y, z};
+
+    unsigned best = 0;
+    real best_variance = -1;
+    for (unsigned a = 0; a < 3; a++)
+    {
+        real sum = 0, square_sum = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            sum += axes[a][i];
+            square_sum += axes[a][i] * axes[a][i];
+        }
+        real mean = sum / count;
+        real variance = square_sum / count - mean * mean;
+        if (variance > best_variance)
+        {
+            best = a;
+            best_variance = variance;
+        }
+    }
+    return best;
+}
+
+void ParticleSweepAndPrune::build(const real *x, const real *y, const real *z, const real *radii, unsigned count)
+{
+    pairs.clear();
+    if (count == 0)
+        return;
+
+    const real *centres[3] = {x, y, z};
+    for (unsigned a = 0; a < 3; a++)
+    {
+        box_min[a].resize(count);
+        box_max[a].resize(count);
+        for (unsigned i = 0; i < count; i++)
+        {
+            box_min[a][i] = centres[a][i] - radii[i];
+            box_max[a][i] = centres[a][i] + radii[i];
+        }
+
+        if (endpoints[a].size() != count * 2)
+        {
+            endpoints[a].resize(count * 2);
+            for (unsigned id = 0; id < count * 2; id++)
+                endpoints[a][id].id = id;
+        }
+        sort_axis(a);
+    }
+
+    sweep_axis = choose_axis(x, y, z, count);
+    const unsigned other_a = (sweep_axis + 1) % 3;
+    const unsigned other_b = (sweep_axis + 2) % 3;
+
+    active.clear();
+    active_position.resize(count);
+    for (std::vector<Endpoint>::const_iterator e = endpoints[sweep_axis].begin(); e != endpoints[sweep_axis].end(); e++)
+    {
+        unsigned i = e->id >> 1;
+        if (e->id & 1)
+        {
+            // swap remove from the open boxes
+            unsigned last = active.back();
+            active[active_position[i]] = last;
+            active_position[last] = active_position[i];
+            active.pop_back();
+            continue;
+        }
+
+        for (std::vector<unsigned>::const_iterator j = active.begin(); j != active.end(); j++)
+        {
+            if (box_min[other_a][i] > box_max[other_a][*j] || box_min[other_a][*j] > box_max[other_a][i] ||
+                box_min[other_b][i] > box_max[other_b][*j] || box_min[other_b][*j] > box_max[other_b][i])
+                continue;
+
+            Pair pair;
+            pair.first = i < *j ? i : *j;
+            pair.second = i < *j ? *j : i;
+            pairs.push_back(pair);
+        }
+
+        active_position[i] = active.size();
+        active.push_back(i);
+    }
+}
+
+ParticleCollisionGenerator::ParticleCollisionGenerator()
+    : particles(0), radius(1), restitution(0), radii(0)
+{
+}
+
+void ParticleCollisionGenerator::init(ParticleWorld::Particles *particles, real radius, real restitution)
+{
+    ParticleCollisionGenerator::particles = particles;
+    ParticleCollisionGenerator::radius = radius;
+    ParticleCollisionGenerator::restitution = restitution;
+}
+
+void ParticleCollisionGenerator::set_radii(const std::vector<real> *radii)
+{
+    ParticleCollisionGenerator::radii = radii;
+}
+
+real ParticleCollisionGenerator::get_radius(unsigned i) const
+{
+    return radii ? (*radii)[i] : radius;
+}
+
+real ParticleCollisionGenerator::get_max_radius() const
+{
+    if (!radii)
+        return radius;
+
+    real max = 0;
+    for (std::vector<real>::const_iterator r = radii->begin(); r != radii->end(); r++)
+    {
+        if (*r > max)
+            max = *r;
+    }
+    return max;
+}
+
+void ParticleCollisionGenerator::gather_positions() const
+{
+    const unsigned count = particles->size();
+    position_x.resize(count);
+    position_y.resize(count);
+    position_z.resize(count);
+    for (unsigned i = 0; i < count; i++)
+    {
+        Vector3 position = (*particles)[i]->get_position();
+        position_x[i] = position.x;
+        position_y[i] = position.y;
+        position_z[i] = position.z;
+    }
+}
+
+void ParticleCollisionGenerator::gather_radii() const
+{
+    if (radii)
+    {
+        point_radius.assign(radii->begin(), radii->begin() + particles->size());
+        return;
+    }
+    point_radius.assign(particles->size(), radius);
+}
+
+unsigned ParticleCollisionGenerator::sphere_contact(unsigned i, unsigned j, ContactOutput &out) const
+{
+    Vector3 offset(position_x[i] - position_x[j], position_y[i] - position_y[j], position_z[i] - position_z[j]);
+    real reach = get_radius(i) + get_radius(j);
+
+    real square_distance = offset.sqare_magnitude();
+    if (square_distance >= reach * reach)
+        return 0;
+
+    // particles sitting exactly on top of each other get pushed apart along y
+    real distance = real_sqrt(square_distance);
+    Vector3 normal = distance > 0 ? offset * (((real)1.0) / distance) : Vector3::UP;
+
+    if (out.compact)
+    {
+        out.compact->add(slots[i], slots[j], normal, reach - distance, restitution);
+        return 1;
+    }
+
+    ParticleContact *contact = out.contact++;
+    contact->particle[0] = (*particles)[i];
+    contact->particle[1] = (*particles)[j];
+    contact->contact_normal = normal;
+    contact->penetration = reach - distance;
+    contact->restitution = restitution;
+    return 1;
+}
+
+unsigned ParticleCollisionGenerator::add_contact(ParticleContact *contact, unsigned limit) const
+{
+    ContactOutput out = {contact, 0};
+    return collide(out, limit);
+}
+
+unsigned ParticleCollisionGenerator::add_contacts(ParticleCompactContacts &contacts, unsigned limit) const
+{
+    if (!particles || limit == 0)
+        return 0;
+
+    const unsigned count = particles->size();
+    slots.resize(count);
+    for (unsigned i = 0; i < count; i++)
+    {
+        const Particle *particle = (*particles)[i];
+        if (!contacts.use_store(particle->get_store()))
+            return ParticleContactGenerator::add_contacts(contacts, limit);
+        slots[i] = particle->get_store()->get_slot(particle->get_handle());
+    }
+
+    ContactOutput out = {0, &contacts};
+    return collide(out, limit);
+}
+
+unsigned ParticleHashCollisions::collide(ContactOutput &out, unsigned limit) const
+{
+    if (!particles || limit == 0)
+        return 0;
+
+    real max_radius = get_max_radius();
+    if (max_radius <= 0)
+        return 0;
+
+    gather_positions();
+    const unsigned count = particles->size();
+
+    hash.set_cell_size(max_radius * 2);
+    hash.build(position_x.data(), position_y.data(), position_z.data(), count);
+
+    unsigned used = 0;
+    unsigned buckets[27];
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned num_buckets = hash.neighbour_buckets(position_x[i], position_y[i], position_z[i], buckets);
+        for (unsigned b = 0; b < num_buckets; b++)
+        {
+            for (const unsigned *j = hash.begin(buckets[b]); j != hash.end(buckets[b]); j++)
+            {
+                // each pair once, from its lower index
+                if (*j <= i)
+                    continue;
+
+                used += sphere_contact(i, *j, out);
+                if (used == limit)
+                    return used;
+            }
+        }
+    }
+    return used;
+}
+
+unsigned ParticleSweepCollisions::collide(ContactOutput &out, unsigned limit) const
+{
+    if (!particles || limit == 0)
+        return 0;
+
+    gather_positions();
+    gather_radii();
+    sweep.build(position_x.data(), position_y.data(), position_z.data(), point_radius.data(), particles->size());
+
+    unsigned used = 0;
+    const std::vector<ParticleSweepAndPrune::Pair> &pairs = sweep.get_pairs();
+    for (std::vector<ParticleSweepAndPrune::Pair>::const_iterator p = pairs.begin(); p != pairs.end(); p++)
+    {
+        used += sphere_contact(p->first, p->second, out);
+        if (used == limit)
+            return used;
+    }
+    return used;
+}
+
+bool ParticleAABB::overlaps(const ParticleAABB &other) const
+{
+    return min.x <= other.max.x && other.min.x <= max.x &&
+           min.y <= other.max.y && other.min.y <= max.y &&
+           min.z <= other.max.z && other.min.z <= max.z;
+}
+
+bool ParticleAABB::contains(const ParticleAABB &other) const
+{
+    return min.x <= other.min.x && other.max.x <= max.x &&
+           min.y <= other.min.y && other.max.y <= max.y &&
+           min.z <= other.min.z && other.max.z <= max.z;
+}
+
+ParticleAABB ParticleAABB::merge(const ParticleAABB &other) const
+{
+    ParticleAABB merged;
+    merged.min = Vector3(min.x < other.min.x ? min.x : other.min.x,
+                         min.y < other.min.y ? min.y : other.min.y,
+                         min.z < other.min.z ? min.z : other.min.z);
+    merged.max = Vector3(max.x > other.max.x ? max.x : other.max.x,
+                         max.y > other.max.y ? max.y : other.max.y,
+                         max.z > other.max.z ? max.z : other.max.z);
+    return merged;
+}
+
+real ParticleAABB::surface_area() const
+{
+    Vector3 size = max - min;
+    return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+ParticleAABBTree::ParticleAABBTree() : root(NONE), free_list(NONE)
+{
+}
+
+unsigned ParticleAABBTree::allocate_node()
+{
+    unsigned node;
+    if (free_list != NONE)
+    {
+        node = free_list;
+        free_list = nodes[node].parent;
+    }
+    else
+    {
+        node = nodes.size();
+        nodes.push_back(Node());
+    }
+
+    nodes[node].parent = NONE;
+    nodes[node].child[0] = NONE;
+    nodes[node].child[1] = NONE;
+    nodes[node].user = 0;
+    nodes[node].categories = 0;
+    nodes[node].height = 0;
+    return node;
+}
+
+void ParticleAABBTree::free_node(unsigned node)
+{
+    nodes[node].parent = free_list;
+    nodes[node].height = NONE;
+    free_list = node;
+}
+
+void ParticleAABBTree::refit(unsigned node)
+{
+    Node &n = nodes[node];
+    const Node &a = nodes[n.child[0]];
+    const Node &b = nodes[n.child[1]];
+    n.box = a.box.merge(b.box);
+    n.categories = a.categories | b.categories;
+    n.height = 1 + (a.height > b.height ? a.height : b.height);
+}
+
+unsigned ParticleAABBTree::insert(const ParticleAABB &box, unsigned user, unsigned categories)
+{
+    unsigned leaf = allocate_node();
+    nodes[leaf].box = box;
+    nodes[leaf].user = user;
+    nodes[leaf].categories = categories;
+    insert_leaf(leaf);
+    return leaf;
+}
+
+void ParticleAABBTree::remove(unsigned proxy)
+{
+    remove_leaf(proxy);
+    free_node(proxy);
+}
+
+bool ParticleAABBTree::move(unsigned proxy, const ParticleAABB &box, real margin)
+{
+    if (nodes[proxy].box.contains(box))
+        return false;
+
+    remove_leaf(proxy);
+    Vector3 fat(margin, margin, margin);
+    nodes[proxy].box.min = box.min - fat;
+    nodes[proxy].box.max = box.max + fat;
+    insert_leaf(proxy);
+    return true;
+}
+
+void ParticleAABBTree::clear()
+{
+    nodes.clear();
+    root = NONE;
+    free_list = NONE;
+}
+
+unsigned ParticleAABBTree::get_height() const
+{
+    return root == NONE ? 0 : nodes[root].height;
+}
+
+void ParticleAABBTree::insert_leaf(unsigned leaf)
+{
+    if (root == NONE)
+    {
+        root = leaf;
+        nodes[root].parent = NONE;
+        return;
+    }
+
+    // walk down to the sibling that grows the total surface area the least
+    const ParticleAABB box = nodes[leaf].box;
+    unsigned index = root;
+    while (!nodes[index].is_leaf())
+    {
+        const Node &node = nodes[index];
+        real area = node.box.surface_area();
+        real combined_area = node.box.merge(box).surface_area();
+
+        // cost of pairing with this node, and the growth every child would pay for descending
+        real cost = 2 * combined_area;
+        real inheritance_cost = 2 * (combined_area - area);
+
+        real child_cost[2];
+        for (unsigned c = 0; c < 2; c++)
+        {
+            const Node &child = nodes[node.child[c]];
+            real grown = child.box.merge(box).surface_area();
+            child_cost[c] = inheritance_cost + (child.is_leaf() ? grown : grown - child.box.surface_area());
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1])
+            break;
+        index = child_cost[0] < child_cost[1] ? node.child[0] : node.child[1];
+    }
+
+    unsigned sibling = index;
+    unsigned old_parent = nodes[sibling].parent;
+    unsigned new_parent = allocate_node();
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].child[0] = sibling;
+    nodes[new_parent].child[1] = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+    refit(new_parent);
+
+    if (old_parent == NONE)
+        root = new_parent;
+    else
+        nodes[old_parent].child[nodes[old_parent].child[0] == sibling ? 0 : 1] = new_parent;
+
+    for (unsigned n = nodes[leaf].parent; n != NONE; n = nodes[n].parent)
+    {
+        n = balance(n);
+        refit(n);
+    }
+}
+
+void ParticleAABBTree::remove_leaf(unsigned leaf)
+{
+    if (leaf == root)
+    {
+        root = NONE;
+        return;
+    }
+
+    unsigned parent = nodes[leaf].parent;
+    unsigned grand_parent = nodes[parent].parent;
+    unsigned sibling = nodes[parent].child[nodes[parent].child[0] == leaf ? 1 : 0];
+
+    // the sibling takes the parent's place
+    free_node(parent);
+    if (grand_parent == NONE)
+    {
+        root = sibling;
+        nodes[sibling].parent = NONE;
+        return;
+    }
+
+    nodes[grand_parent].child[nodes[grand_parent].child[0] == parent ? 0 : 1] = sibling;
+    nodes[sibling].parent = grand_parent;
+
+    for (unsigned n = grand_parent; n != NONE; n = nodes[n].parent)
+    {
+        n = balance(n);
+        refit(n);
+    }
+}
+
+// rotates a grandchild up when one side of node is more than one level taller than the other
+// returns the node now in node's place
+unsigned ParticleAABBTree::balance(unsigned a)
+{
+    if (nodes[a].is_leaf() || nodes[a].height < 2)
+        return a;
+
+    unsigned b = nodes[a].child[0];
+    unsigned c = nodes[a].child[1];
+    int difference = int(nodes[c].height) - int(nodes[b].height);
+    if (difference >= -1 && difference <= 1)
+        return a;
+
+    // tall is the child being raised, short stays under a
+    unsigned tall = difference > 1 ? c : b;
+    unsigned short_child = difference > 1 ? b : c;
+    unsigned tall_side = difference > 1 ? 1 : 0;
+
+    unsigned f = nodes[tall].child[0];
+    unsigned g = nodes[tall].child[1];
+
+    // tall takes a's place
+    nodes[tall].child[0] = a;
+    nodes[tall].parent = nodes[a].parent;
+    nodes[a].parent = tall;
+
+    if (nodes[tall].parent == NONE)
+        root = tall;
+    else
+    {
+        unsigned parent = nodes[tall].parent;
+        nodes[parent].child[nodes[parent].child[0] == a ? 0 : 1] = tall;
+    }
+
+    // the taller grandchild stays with tall, the other one moves under a
+    unsigned keep = nodes[f].height > nodes[g].height ? f : g;
+    unsigned give = keep == f ? g : f;
+
+    nodes[tall].child[1] = keep;
+    nodes[a].child[tall_side] = give;
+    nodes[a].child[1 - tall_side] = short_child;
+    nodes[give].parent = a;
+
+    refit(a);
+    refit(tall);
+    return tall;
+}
+
+ParticleTreeCollisions::ParticleTreeCollisions(real margin) : margin(margin), collide_particles(true)
+{
+}
+
+void ParticleTreeCollisions::add_obstacle(const Vector3 &min, const Vector3 &max)
+{
+    ParticleAABB box;
+    box.min = min;
+    box.max = max;
+    tree.insert(box, obstacles.size(), OBSTACLE);
+    obstacles.push_back(box);
+}
+
+void ParticleTreeCollisions::clear_obstacles()
+{
+    // particles go back in on the next frame
+    tree.clear();
+    obstacles.clear();
+    particle_proxies.clear();
+}
+
+unsigned ParticleTreeCollisions::get_obstacle_count() const
+{
+    return obstacles.size();
+}
+
+void ParticleTreeCollisions::set_collide_particles(bool collide_particles)
+{
+    ParticleTreeCollisions::collide_particles = collide_particles;
+}
+
+ParticleAABBTree &ParticleTreeCollisions::get_tree()
+{
+    return tree;
+}
+
+void ParticleTreeCollisions::update_particles() const
+{
+    const unsigned count = particles->size();
+
+    // a different particle count starts the particle leaves over, obstacles stay where they are
+    if (particle_proxies.size() != count)
+    {
+        for (std::vector<unsigned>::iterator p = particle_proxies.begin(); p != particle_proxies.end(); p++)
+            tree.remove(*p);
+        particle_proxies.clear();
+
+        ParticleAABB empty;
+        empty.min = empty.max = Vector3(position_x[0], position_y[0], position_z[0]);
+        for (unsigned i = 0; i < count; i++)
+            particle_proxies.push_back(tree.insert(empty, i, PARTICLE));
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        real r = get_radius(i);
+        ParticleAABB box;
+        box.min = Vector3(position_x[i] - r, position_y[i] - r, position_z[i] - r);
+        box.max = Vector3(position_x[i] + r, position_y[i] + r, position_z[i] + r);
+        tree.move(particle_proxies[i], box, r * margin);
+    }
+}
+
+unsigned ParticleTreeCollisions::box_contact(unsigned i, const ParticleAABB &box, ContactOutput &out) const
+{
+    Vector3 centre(position_x[i], position_y[i], position_z[i]);
+    real r = get_radius(i);
+
+    Vector3 closest(centre.x < box.min.x ? box.min.x : (centre.x > box.max.x ? box.max.x : centre.x),
+                    centre.y < box.min.y ? box.min.y : (centre.y > box.max.y ? box.max.y : centre.y),
+                    centre.z < box.min.z ? box.min.z : (centre.z > box.max.z ? box.max.z : centre.z));
+    Vector3 offset = centre - closest;
+    real square_distance = offset.sqare_magnitude();
+    if (square_distance >= r * r)
+        return 0;
+
+    Vector3 normal;
+    real penetration;
+    if (square_distance > 0)
+    {
+        real distance = real_sqrt(square_distance);
+        normal = offset * (((real)1.0) / distance);
+        penetration = r - distance;
+    }
+    else
+    {
+        // centre inside the box, push out through the nearest face
+        real depths[6] = {centre.x - box.min.x, box.max.x - centre.x,
+                          centre.y - box.min.y, box.max.y - centre.y,
+                          centre.z - box.min.z, box.max.z - centre.z};
+        const Vector3 normals[6] = {Vector3(-1, 0, 0), Vector3(1, 0, 0),
+                                    Vector3(0, -1, 0), Vector3(0, 1, 0),
+                                    Vector3(0, 0, -1), Vector3(0, 0, 1)};
+        unsigned face = 0;
+        for (unsigned f = 1; f < 6; f++)
+        {
+            if (depths[f] < depths[face])
+                face = f;
+        }
+        normal = normals[face];
+        penetration = r + depths[face];
+    }
+
+    if (out.compact)
+    {
+        out.compact->add(slots[i], normal, penetration, restitution);
+        return 1;
+    }
+
+    ParticleContact *contact = out.contact++;
+    contact->particle[0] = (*particles)[i];
+    contact->particle[1] = NULL;
+    contact->contact_normal = normal;
+    contact->penetration = penetration;
+    contact->restitution = restitution;
+    return 1;
+}
+
+unsigned ParticleTreeCollisions::collide(ContactOutput &out, unsigned limit) const
+{
+    if (!particles || particles->empty() || limit == 0)
+        return 0;
+
+    gather_positions();
+    update_particles();
+
+    const unsigned count = particles->size();
+    const unsigned categories = collide_particles ? OBSTACLE | PARTICLE : OBSTACLE;
+
+    unsigned used = 0;
+    for (unsigned i = 0; i < count && used < limit; i++)
+    {
+        real r = get_radius(i);
+        ParticleAABB box;
+        box.min = Vector3(position_x[i] - r, position_y[i] - r, position_z[i] - r);
+        box.max = Vector3(position_x[i] + r, position_y[i] + r, position_z[i] + r);
+
+        tree.query(box, categories, [&](unsigned proxy)
+                   {
+            unsigned other = tree.get_user(proxy);
+            if (tree.get_categories(proxy) == OBSTACLE)
+                used += box_contact(i, obstacles[other], out);
+            // each pair once, from its lower index
+            else if (other > i)
+                used += sphere_contact(i, other, out);
+            return used < limit; });
+    }
+    return used;
+}
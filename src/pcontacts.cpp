@@ -1,15 +1,23 @@
 #include "gabbyphysics/pcontacts.h"
+#include "gabbyphysics/simd.h"
+
+#include "algorithm"
+#include "functional"
 
 using namespace gabbyphysics;
 
 void ParticleContact::resolve(real duration)
 {
+    Vector3 movement[2];
     resolve_velocity(duration);
-    resolve_interpenetration(duration);
+    resolve_interpenetration(duration, movement);
 }
 
-void ParticleContact::resolve_interpenetration(real duration)
+void ParticleContact::resolve_interpenetration(real duration, Vector3 movement[2])
 {
+    movement[0].clear();
+    movement[1].clear();
+
     if (penetration <= 0)
         return;
 
@@ -21,12 +29,34 @@ void ParticleContact::resolve_interpenetration(real duration)
     if (total_inverse_mass <= 0)
         return;
 
-    Vector3 move_per_inv_mass = contact_normal * (-penetration / total_inverse_mass);
+    // the normal points the way particle 0 has to move, particle 1 moves the other way
+    Vector3 move_per_inv_mass = contact_normal * (penetration / total_inverse_mass);
 
-    particle[0]->set_position(particle[0]->get_position() + move_per_inv_mass * particle[0]->get_inverse_mass());
+    movement[0] = move_per_inv_mass * particle[0]->get_inverse_mass();
+    particle[0]->set_position(particle[0]->get_position() + movement[0]);
     if (particle[1])
     {
-        particle[1]->set_position(particle[1]->get_position() + move_per_inv_mass * particle[1]->get_inverse_mass());
+        movement[1] = move_per_inv_mass * -particle[1]->get_inverse_mass();
+        particle[1]->set_position(particle[1]->get_position() + movement[1]);
+    }
+}
+
+// accounts for the particles of resolved having moved by movement, if contact shares any of them
+static void update_penetration(ParticleContact &contact, const ParticleContact &resolved, const Vector3 movement[2])
+{
+    const ParticleKey moved[2] = {resolved.particle[0], resolved.particle[1]};
+    for (unsigned side = 0; side < 2; side++)
+    {
+        if (!contact.particle[side])
+            continue;
+
+        // moving particle 0 along the normal or particle 1 against it both reduce penetration
+        real sign = side == 0 ? -1 : 1;
+        ParticleKey key = contact.particle[side];
+        if (key == moved[0])
+            contact.penetration += sign * (movement[0] * contact.contact_normal);
+        else if (key == moved[1])
+            contact.penetration += sign * (movement[1] * contact.contact_normal);
     }
 }
 
@@ -83,17 +113,26 @@ void ParticleContact::resolve_velocity(real duration)
     }
 }
 
-ParticleContactResolver::ParticleContactResolver(unsigned iterations) : iterations(iterations)
+ParticleContactResolver::ParticleContactResolver(unsigned iterations, Mode mode)
+    : iterations(iterations), iterations_used(0), mode(mode), velocity_epsilon(0)
 {
 }
 
 void ParticleContactResolver::resolve_contacts(ParticleContact *contact_array, unsigned num_contacts, real duration)
+{
+    if (mode == PRIORITY)
+        resolve_contacts_priority(contact_array, num_contacts, duration);
+    else
+        resolve_contacts_iterative(contact_array, num_contacts, duration);
+}
+
+void ParticleContactResolver::resolve_contacts_iterative(ParticleContact *contact_array, unsigned num_contacts, real duration)
 {
     iterations_used = 0;
     while (iterations_used < iterations)
     {
         // find largest closing velocity
-        real max = 0;
+        real max = -velocity_epsilon;
         unsigned max_idx = num_contacts;
         for (unsigned i = 0; i < num_contacts; i++)
         {
@@ -105,8 +144,624 @@ void ParticleContactResolver::resolve_contacts(ParticleContact *contact_array, u
             }
         }
 
-        contact_array[max_idx].resolve(duration);
+        // nothing is closing so there is nothing left to resolve
+        if (max_idx == num_contacts)
+            break;
+
+        Vector3 movement[2];
+        contact_array[max_idx].resolve_velocity(duration);
+        contact_array[max_idx].resolve_interpenetration(duration, movement);
         iterations_used++;
+
+        // resolving moved the particles, so every contact sharing one is now more or less penetrating
+        for (unsigned i = 0; i < num_contacts; i++)
+            update_penetration(contact_array[i], contact_array[max_idx], movement);
+    }
+}
+
+// smallest of values and start, lane wise with a scalar tail
+static real min_separating(const real *values, unsigned count, real start)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    realv lowest = realv::broadcast(start);
+    unsigned i = 0;
+    for (; i + width <= count; i += width)
+    {
+        realv v = realv::load(values + i);
+        lowest = realv::select_greater(lowest, v, v, lowest);
+    }
+
+    real lanes[GABBYPHYSICS_SIMD_WIDTH];
+    lowest.store(lanes);
+    real min = start;
+    for (unsigned lane = 0; lane < width; lane++)
+        min = lanes[lane] < min ? lanes[lane] : min;
+    for (; i < count; i++)
+        min = values[i] < min ? values[i] : min;
+    return min;
+}
+
+// ParticleCompactContacts::unpack_normal a lane at a time, in whole steps and without the normalize
+static void unfold_normals(const unsigned *packed, realv &x, realv &y, realv &z)
+{
+    const realv zero = realv::broadcast(0), steps = realv::broadcast(32767);
+    x = realv::load_u16(packed, 0) - steps;
+    y = realv::load_u16(packed, 16) - steps;
+    z = steps - realv::select_greater(x, zero, x, zero - x) - realv::select_greater(y, zero, y, zero - y);
+
+    // the lower half of the octahedron was folded over the diagonals
+    realv fold = realv::select_greater(zero, z, zero - z, zero);
+    x = x + realv::select_greater(zero, x, fold, zero - fold);
+    y = y + realv::select_greater(zero, y, fold, zero - fold);
+}
+
+// the point on the octahedron packed stands for, scaled up to whole steps, |x| + |y| + |z| = 32767
+static Vector3 unfold_normal(unsigned packed)
+{
+    Vector3 normal(real(int(packed & 0xffff) - 32767), real(int(packed >> 16) - 32767), 0);
+    normal.z = 32767 - real_abs(normal.x) - real_abs(normal.y);
+
+    real fold = normal.z < 0 ? -normal.z : 0;
+    normal.x += normal.x >= 0 ? -fold : fold;
+    normal.y += normal.y >= 0 ? -fold : fold;
+    return normal;
+}
+
+static void scale_normals(const ParticleCompactContacts::Columns &columns, std::vector<real> &scale)
+{
+    scale.resize(columns.size());
+    for (unsigned i = 0; i < columns.size(); i++)
+        scale[i] = 1 / unfold_normal(columns.normal[i]).magnitude();
+}
+
+// fills separating with the separating velocity of every contact in columns, gathering velocities by slot
+// the normals are only unfolded, scale is 1 / the length of each, scenery columns have no second particle
+static void scan_compact(const ParticleCompactContacts::Columns &columns, bool scenery, const ParticleStore &store,
+                         const real *scale, real *separating)
+{
+    const unsigned count = columns.size();
+    const unsigned *first = columns.first.data(), *second = columns.second.data(), *packed = columns.normal.data();
+    const real *vx = store.velocity_x.data(), *vy = store.velocity_y.data(), *vz = store.velocity_z.data();
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+
+    unsigned i = 0;
+    for (; i + width <= count; i += width)
+    {
+        realv x, y, z;
+        unfold_normals(packed + i, x, y, z);
+
+        realv dx = realv::gather(vx, first + i), dy = realv::gather(vy, first + i), dz = realv::gather(vz, first + i);
+        if (!scenery)
+        {
+            dx = dx - realv::gather(vx, second + i);
+            dy = dy - realv::gather(vy, second + i);
+            dz = dz - realv::gather(vz, second + i);
+        }
+        ((dx * x + dy * y + dz * z) * realv::load(scale + i)).store(separating + i);
+    }
+    for (; i < count; i++)
+    {
+        Vector3 velocity = store.get_velocity(first[i]);
+        if (!scenery)
+            velocity -= store.get_velocity(second[i]);
+        separating[i] = (velocity * unfold_normal(packed[i])) * scale[i];
+    }
+}
+
+// groups the contacts by slot, immovable particles never move so they get no entries
+void ParticleContactResolver::build_slot_contacts(const ParticleCompactContacts &contacts, const ParticleStore &store)
+{
+    const ParticleCompactContacts::Columns *sets[2] = {&contacts.pairs, &contacts.scenery};
+    const unsigned pairs = contacts.pairs.size();
+
+    slot_contacts.clear();
+    for (unsigned c = 0; c < 2; c++)
+    {
+        for (unsigned i = 0; i < sets[c]->size(); i++)
+        {
+            for (unsigned side = 0; side < 2 - c; side++)
+            {
+                unsigned slot = side == 0 ? sets[c]->first[i] : sets[c]->second[i];
+                if (store.inverse_mass[slot] > 0)
+                    slot_contacts.push_back({slot, c == 0 ? i : pairs + i, side});
+            }
+        }
+    }
+
+    std::sort(slot_contacts.begin(), slot_contacts.end(),
+              [](const SlotContact &a, const SlotContact &b)
+              { return a.slot < b.slot || (a.slot == b.slot && a.contact < b.contact); });
+
+    slot_contacts_begin.assign(contacts.size() * 2, 0);
+    slot_contacts_end.assign(contacts.size() * 2, 0);
+
+    unsigned run_begin = 0;
+    for (unsigned i = 1; i <= slot_contacts.size(); i++)
+    {
+        if (i < slot_contacts.size() && slot_contacts[i].slot == slot_contacts[run_begin].slot)
+            continue;
+
+        for (unsigned j = run_begin; j < i; j++)
+        {
+            unsigned entry = slot_contacts[j].contact * 2 + slot_contacts[j].side;
+            slot_contacts_begin[entry] = run_begin;
+            slot_contacts_end[entry] = i;
+        }
+        run_begin = i;
+    }
+}
+
+void ParticleContactResolver::resolve_contacts(ParticleCompactContacts &contacts, real duration)
+{
+    iterations_used = 0;
+    if (contacts.size() == 0)
+        return;
+
+    ParticleStore &store = *contacts.get_store();
+    build_slot_contacts(contacts, store);
+    scale_normals(contacts.pairs, normal_scale);
+    scale_normals(contacts.scenery, scenery_normal_scale);
+    separating_velocity.resize(contacts.pairs.size());
+    scenery_separating_velocity.resize(contacts.scenery.size());
+
+    while (iterations_used < iterations)
+    {
+        // find largest closing velocity, the velocities, their min and the first contact reaching it in separate passes
+        // pair contacts come first on a tie
+        scan_compact(contacts.pairs, false, store, normal_scale.data(), separating_velocity.data());
+        scan_compact(contacts.scenery, true, store, scenery_normal_scale.data(), scenery_separating_velocity.data());
+        real max = min_separating(separating_velocity.data(), separating_velocity.size(), -velocity_epsilon);
+        max = min_separating(scenery_separating_velocity.data(), scenery_separating_velocity.size(), max);
+
+        // nothing is closing so there is nothing left to resolve
+        if (max >= -velocity_epsilon)
+            break;
+
+        ParticleCompactContacts::Columns *columns = &contacts.pairs;
+        const real *separating = separating_velocity.data();
+        unsigned max_idx = std::find(separating, separating + columns->size(), max) - separating;
+        bool scenery = max_idx == columns->size();
+        if (scenery)
+        {
+            columns = &contacts.scenery;
+            separating = scenery_separating_velocity.data();
+            max_idx = std::find(separating, separating + columns->size(), max) - separating;
+        }
+
+        const real *scale = scenery ? scenery_normal_scale.data() : normal_scale.data();
+        Vector3 movement[2];
+        resolve_compact(store, *columns, scenery, max_idx, unfold_normal(columns->normal[max_idx]) * scale[max_idx],
+                        max, duration, movement);
+        iterations_used++;
+
+        // resolving moved the particles, so every contact sharing one is now more or less penetrating
+        const unsigned moved[2] = {columns->first[max_idx], scenery ? ParticleStore::INVALID_SLOT : columns->second[max_idx]};
+        const unsigned resolved = scenery ? contacts.pairs.size() + max_idx : max_idx;
+        for (unsigned side = 0; side < 2; side++)
+        {
+            if (moved[side] == ParticleStore::INVALID_SLOT)
+                continue;
+
+            for (unsigned n = slot_contacts_begin[resolved * 2 + side]; n < slot_contacts_end[resolved * 2 + side]; n++)
+            {
+                unsigned contact = slot_contacts[n].contact;
+                ParticleCompactContacts::Columns &touching = contact < contacts.pairs.size() ? contacts.pairs : contacts.scenery;
+                const real *touching_scale = contact < contacts.pairs.size() ? normal_scale.data() : scenery_normal_scale.data();
+                if (contact >= contacts.pairs.size())
+                    contact -= contacts.pairs.size();
+
+                // moving particle 0 along the normal or particle 1 against it both reduce penetration
+                real along = (movement[side] * unfold_normal(touching.normal[contact])) * touching_scale[contact];
+                touching.penetration[contact] += touching.first[contact] == moved[side] ? -along : along;
+            }
+        }
+    }
+}
+
+// same steps as ParticleContact::resolve_velocity and resolve_interpenetration on the store's slots
+void ParticleContactResolver::resolve_compact(ParticleStore &store, ParticleCompactContacts::Columns &columns, bool scenery,
+                                              unsigned i, const Vector3 &normal, real separating, real duration, Vector3 movement[2])
+{
+    const unsigned slot[2] = {columns.first[i], scenery ? ParticleStore::INVALID_SLOT : columns.second[i]};
+    const unsigned sides = scenery ? 1 : 2;
+    const real restitution = columns.restitution[i];
+    const real direction[2] = {1, -1};
+
+    movement[0].clear();
+    movement[1].clear();
+
+    real total_inverse_mass = 0;
+    Vector3 accel_caused_velocity;
+    for (unsigned side = 0; side < sides; side++)
+    {
+        total_inverse_mass += store.inverse_mass[slot[side]];
+        accel_caused_velocity += store.get_acceleration(slot[side]) * direction[side];
+    }
+
+    if (separating <= 0)
+    {
+        real new_separating_velocity = -separating * restitution;
+
+        // check velocity due to acceleration only to handle resting contact
+        real accel_caused_sep_velocity = accel_caused_velocity * normal * duration;
+        if (accel_caused_sep_velocity < 0)
+        {
+            new_separating_velocity += restitution * accel_caused_sep_velocity;
+            if (new_separating_velocity < 0)
+                new_separating_velocity = 0;
+        }
+
+        if (total_inverse_mass > 0)
+        {
+            Vector3 impulse_per_invmass = normal * ((new_separating_velocity - separating) / total_inverse_mass);
+            for (unsigned side = 0; side < sides; side++)
+                store.set_velocity(slot[side], store.get_velocity(slot[side]) + impulse_per_invmass * (direction[side] * store.inverse_mass[slot[side]]));
+        }
+    }
+
+    if (columns.penetration[i] <= 0 || total_inverse_mass <= 0)
+        return;
+
+    // the normal points the way particle 0 has to move, particle 1 moves the other way
+    Vector3 move_per_inv_mass = normal * (columns.penetration[i] / total_inverse_mass);
+    for (unsigned side = 0; side < sides; side++)
+    {
+        movement[side] = move_per_inv_mass * (direction[side] * store.inverse_mass[slot[side]]);
+        store.set_position(slot[side], store.get_position(slot[side]) + movement[side]);
+    }
+}
+
+ParticleCompactContacts::ParticleCompactContacts()
+    : store(0), mixed(false)
+{
+}
+
+bool ParticleCompactContacts::use_store(ParticleStore *store)
+{
+    if (!ParticleCompactContacts::store)
+        ParticleCompactContacts::store = store;
+    return ParticleCompactContacts::store == store;
+}
+
+// x, y in [-1, 1] to 16 bits each, whole steps so 0 and the axes are exact
+static unsigned quantise_normal(real value)
+{
+    real steps = real_floor((value + 1) * 32767 + real(0.5));
+    if (steps < 0)
+        steps = 0;
+    if (steps > 65534)
+        steps = 65534;
+    return unsigned(int(steps));
+}
+
+unsigned ParticleCompactContacts::pack_normal(const Vector3 &normal)
+{
+    // project on to the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one
+    real l1 = real_abs(normal.x) + real_abs(normal.y) + real_abs(normal.z);
+    real x = normal.x / l1;
+    real y = normal.y / l1;
+    if (normal.z < 0)
+    {
+        real folded_x = (1 - real_abs(y)) * (x >= 0 ? 1 : -1);
+        y = (1 - real_abs(x)) * (y >= 0 ? 1 : -1);
+        x = folded_x;
+    }
+    return quantise_normal(x) | quantise_normal(y) << 16;
+}
+
+Vector3 ParticleCompactContacts::unpack_normal(unsigned packed)
+{
+    Vector3 normal = unfold_normal(packed);
+    normal.normalize();
+    return normal;
+}
+
+void ParticleCompactContacts::add(unsigned first, unsigned second, const Vector3 &normal, real penetration, real restitution)
+{
+    if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+        return;
+
+    pairs.first.push_back(first);
+    pairs.second.push_back(second);
+    pairs.normal.push_back(pack_normal(normal));
+    pairs.restitution.push_back(restitution);
+    pairs.penetration.push_back(penetration);
+}
+
+void ParticleCompactContacts::add(unsigned first, const Vector3 &normal, real penetration, real restitution)
+{
+    if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+        return;
+
+    scenery.first.push_back(first);
+    scenery.normal.push_back(pack_normal(normal));
+    scenery.restitution.push_back(restitution);
+    scenery.penetration.push_back(penetration);
+}
+
+void ParticleCompactContacts::add(const ParticleContact &contact)
+{
+    const Particle *first = contact.particle[0], *second = contact.particle[1];
+    if (!use_store(first->get_store()) || (second && !use_store(second->get_store())))
+    {
+        mixed = true;
+        return;
+    }
+
+    if (second)
+        add(store->get_slot(first->get_handle()), store->get_slot(second->get_handle()),
+            contact.contact_normal, contact.penetration, contact.restitution);
+    else
+        add(store->get_slot(first->get_handle()), contact.contact_normal, contact.penetration, contact.restitution);
+}
+
+// from and to are sizes of source's columns
+static void append_columns(ParticleCompactContacts::Columns &columns, const ParticleCompactContacts::Columns &source,
+                           unsigned from, unsigned to, bool scenery)
+{
+    columns.first.insert(columns.first.end(), source.first.begin() + from, source.first.begin() + to);
+    if (!scenery)
+        columns.second.insert(columns.second.end(), source.second.begin() + from, source.second.begin() + to);
+    columns.normal.insert(columns.normal.end(), source.normal.begin() + from, source.normal.begin() + to);
+    columns.restitution.insert(columns.restitution.end(), source.restitution.begin() + from, source.restitution.begin() + to);
+    columns.penetration.insert(columns.penetration.end(), source.penetration.begin() + from, source.penetration.begin() + to);
+}
+
+void ParticleCompactContacts::append(const ParticleCompactContacts &other, Mark from, Mark to)
+{
+    if (from.pairs == to.pairs && from.scenery == to.scenery)
+        return;
+
+    if (other.mixed || !use_store(other.store))
+    {
+        mixed = true;
+        return;
+    }
+
+    append_columns(pairs, other.pairs, from.pairs, to.pairs, false);
+    append_columns(scenery, other.scenery, from.scenery, to.scenery, true);
+}
+
+void ParticleCompactContacts::reserve(unsigned capacity)
+{
+    Columns *sets[2] = {&pairs, &scenery};
+    for (unsigned c = 0; c < 2; c++)
+    {
+        sets[c]->first.reserve(capacity);
+        if (c == 0)
+            sets[c]->second.reserve(capacity);
+        sets[c]->normal.reserve(capacity);
+        sets[c]->restitution.reserve(capacity);
+        sets[c]->penetration.reserve(capacity);
+    }
+}
+
+void ParticleCompactContacts::clear()
+{
+    Columns *sets[2] = {&pairs, &scenery};
+    for (unsigned c = 0; c < 2; c++)
+    {
+        sets[c]->first.clear();
+        sets[c]->second.clear();
+        sets[c]->normal.clear();
+        sets[c]->restitution.clear();
+        sets[c]->penetration.clear();
+    }
+    store = 0;
+    mixed = false;
+}
+
+unsigned ParticleContactGenerator::add_contacts(ParticleCompactContacts &contacts, unsigned limit) const
+{
+    // grows like ParticleWorld's arena and is shared by every generator on the thread
+    static thread_local std::vector<ParticleContact> buffer(16);
+    if (limit == 0)
+        return 0;
+
+    for (;;)
+    {
+        unsigned room = buffer.size() < limit ? buffer.size() : limit;
+        unsigned added = add_contact(buffer.data(), room);
+        if (added == room && room < limit)
+        {
+            buffer.resize(buffer.size() * 2);
+            continue;
+        }
+
+        for (unsigned i = 0; i < added; i++)
+            contacts.add(buffer[i]);
+        return added;
+    }
+}
+
+void ParticleContactNeighbours::build(const ParticleContact *contact_array, unsigned num_contacts)
+{
+    particle_contacts.clear();
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        for (unsigned side = 0; side < 2; side++)
+        {
+            const Particle *particle = contact_array[i].particle[side];
+            // immovable particles never change velocity or position so they dont link contacts together
+            // views of the same store slot are the same particle, so contacts are grouped by slot not address
+            if (particle && particle->has_finite_mass())
+                particle_contacts.push_back({particle, i, side});
+        }
+    }
+
+    std::sort(particle_contacts.begin(), particle_contacts.end(),
+              [](const ParticleContactRef &a, const ParticleContactRef &b)
+              { return a.particle < b.particle; });
+
+    neighbour_begin.assign(num_contacts * 2, 0);
+    neighbour_end.assign(num_contacts * 2, 0);
+
+    unsigned run_begin = 0;
+    for (unsigned i = 1; i <= particle_contacts.size(); i++)
+    {
+        if (i < particle_contacts.size() && particle_contacts[i].particle == particle_contacts[run_begin].particle)
+            continue;
+
+        for (unsigned j = run_begin; j < i; j++)
+        {
+            unsigned slot = particle_contacts[j].contact * 2 + particle_contacts[j].side;
+            neighbour_begin[slot] = run_begin;
+            neighbour_end[slot] = i;
+        }
+        run_begin = i;
+    }
+}
+
+void ParticleContactNeighbours::gather(unsigned contact, std::vector<unsigned> &out) const
+{
+    out.clear();
+    for (unsigned n = begin(contact, 0); n < end(contact, 0); n++)
+        out.push_back(get_contact(n));
+
+    const unsigned shared = out.size();
+    for (unsigned n = begin(contact, 1); n < end(contact, 1); n++)
+    {
+        // contacts between the same two particles turn up on both sides
+        unsigned other = get_contact(n);
+        if (std::find(out.begin(), out.begin() + shared, other) == out.begin() + shared)
+            out.push_back(other);
+    }
+}
+
+void ParticleContactColouring::build(const ParticleContactNeighbours &neighbours, unsigned num_contacts)
+{
+    const unsigned uncoloured = MAX_COLOURS + 1;
+    colours.assign(num_contacts, uncoloured);
+
+    // lowest colour none of the already coloured neighbours has, the serial batch MAX_COLOURS if all are taken
+    unsigned long long full = ~0ull;
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        neighbours.gather(i, touched);
+
+        unsigned long long used = 0;
+        for (std::vector<unsigned>::iterator t = touched.begin(); t != touched.end(); t++)
+        {
+            if (colours[*t] < MAX_COLOURS)
+                used |= 1ull << colours[*t];
+        }
+
+        unsigned colour = 0;
+        if (used == full)
+            colour = MAX_COLOURS;
+        else
+            while (used & (1ull << colour))
+                colour++;
+        colours[i] = colour;
+    }
+
+    // counting sort into batches
+    batch_start.assign(MAX_COLOURS + 2, 0);
+    for (unsigned i = 0; i < num_contacts; i++)
+        batch_start[colours[i] + 1]++;
+
+    unsigned last_used = 0;
+    for (unsigned c = 0; c <= MAX_COLOURS; c++)
+    {
+        if (batch_start[c + 1] > 0)
+            last_used = c;
+        batch_start[c + 1] += batch_start[c];
+    }
+
+    order.resize(num_contacts);
+    next.assign(batch_start.begin(), batch_start.end() - 1);
+    for (unsigned i = 0; i < num_contacts; i++)
+        order[next[colours[i]]++] = i;
+
+    // drop the empty colours at the end, the serial batch included when nothing overflowed
+    batch_start.resize(last_used + 2);
+}
+
+void ParticleContactResolver::heap_swap(unsigned a, unsigned b)
+{
+    std::swap(heap[a], heap[b]);
+    heap_position[heap[a]] = a;
+    heap_position[heap[b]] = b;
+}
+
+// the heap keeps the most negative separating velocity, the fastest closing contact, at the top
+void ParticleContactResolver::sift_up(unsigned position)
+{
+    while (position > 0)
+    {
+        unsigned parent = (position - 1) / 2;
+        if (separating_velocity[heap[parent]] <= separating_velocity[heap[position]])
+            return;
+        heap_swap(parent, position);
+        position = parent;
+    }
+}
+
+void ParticleContactResolver::sift_down(unsigned position)
+{
+    const unsigned size = heap.size();
+    while (true)
+    {
+        unsigned smallest = position;
+        unsigned left = position * 2 + 1;
+        unsigned right = left + 1;
+        if (left < size && separating_velocity[heap[left]] < separating_velocity[heap[smallest]])
+            smallest = left;
+        if (right < size && separating_velocity[heap[right]] < separating_velocity[heap[smallest]])
+            smallest = right;
+        if (smallest == position)
+            return;
+        heap_swap(smallest, position);
+        position = smallest;
+    }
+}
+
+void ParticleContactResolver::resolve_contacts_priority(ParticleContact *contact_array, unsigned num_contacts, real duration)
+{
+    iterations_used = 0;
+    if (num_contacts == 0)
+        return;
+
+    neighbours.build(contact_array, num_contacts);
+
+    separating_velocity.resize(num_contacts);
+    heap.resize(num_contacts);
+    heap_position.resize(num_contacts);
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        separating_velocity[i] = contact_array[i].calculate_separating_velocity();
+        heap[i] = i;
+        heap_position[i] = i;
+    }
+    for (unsigned i = num_contacts / 2; i-- > 0;)
+        sift_down(i);
+
+    while (iterations_used < iterations)
+    {
+        unsigned top = heap[0];
+        if (separating_velocity[top] >= -velocity_epsilon)
+            break;
+
+        Vector3 movement[2];
+        contact_array[top].resolve_velocity(duration);
+        contact_array[top].resolve_interpenetration(duration, movement);
+        iterations_used++;
+
+        // only contacts sharing a movable particle with the resolved one can have changed
+        neighbours.gather(top, touched);
+        for (std::vector<unsigned>::iterator t = touched.begin(); t != touched.end(); t++)
+        {
+            unsigned contact = *t;
+            update_penetration(contact_array[contact], contact_array[top], movement);
+
+            real old_velocity = separating_velocity[contact];
+            separating_velocity[contact] = contact_array[contact].calculate_separating_velocity();
+
+            if (separating_velocity[contact] < old_velocity)
+                sift_up(heap_position[contact]);
+            else
+                sift_down(heap_position[contact]);
+        }
     }
 }
 
@@ -114,3 +769,235 @@ void ParticleContactResolver::set_iterations(unsigned iterations)
 {
     ParticleContactResolver::iterations = iterations;
 }
+
+void ParticleContactResolver::set_mode(Mode mode)
+{
+    ParticleContactResolver::mode = mode;
+}
+
+ParticleContactResolver::Mode ParticleContactResolver::get_mode() const
+{
+    return mode;
+}
+
+void ParticleContactResolver::set_velocity_epsilon(real velocity_epsilon)
+{
+    ParticleContactResolver::velocity_epsilon = velocity_epsilon;
+}
+
+unsigned ParticleContactResolver::get_iterations_used() const
+{
+    return iterations_used;
+}
+
+size_t ParticleContactSolver::ContactKeyHash::operator()(const ContactKey &key) const
+{
+    size_t a = std::hash<const ParticleStore *>()(key.first.store) ^ key.first.handle;
+    size_t b = std::hash<const ParticleStore *>()(key.second.store) ^ key.second.handle;
+    return a ^ (b + 0x9e3779b9 + (a << 6) + (a >> 2));
+}
+
+ParticleContactSolver::ContactKey ParticleContactSolver::make_key(const ParticleContact &contact, Vector3 &normal)
+{
+    normal = contact.contact_normal;
+    ParticleKey first = contact.particle[0], second = contact.particle[1];
+    if (first < second)
+        return {first, second};
+
+    normal *= -1;
+    return {second, first};
+}
+
+ParticleContactSolver::ParticleContactSolver(unsigned sweeps, real warm_start_factor)
+    : sweeps(sweeps), warm_start_factor(warm_start_factor)
+{
+}
+
+void ParticleContactSolver::set_sweeps(unsigned sweeps)
+{
+    ParticleContactSolver::sweeps = sweeps;
+}
+
+unsigned ParticleContactSolver::get_sweeps() const
+{
+    return sweeps;
+}
+
+void ParticleContactSolver::set_warm_start_factor(real warm_start_factor)
+{
+    ParticleContactSolver::warm_start_factor = warm_start_factor;
+}
+
+void ParticleContactSolver::reset_warm_start()
+{
+    previous_impulses.clear();
+}
+
+// same direction convention as ParticleContact::resolve_velocity, a positive impulse pushes the particles apart
+void ParticleContactSolver::apply_impulse(ParticleContact &contact, real impulse)
+{
+    Vector3 impulse_per_invmass = contact.contact_normal * impulse;
+
+    Particle *first = contact.particle[0];
+    if (first->has_finite_mass())
+        first->set_velocity(first->get_velocity() + impulse_per_invmass * first->get_inverse_mass());
+
+    Particle *second = contact.particle[1];
+    if (second && second->has_finite_mass())
+        second->set_velocity(second->get_velocity() + impulse_per_invmass * -second->get_inverse_mass());
+}
+
+void ParticleContactSolver::solve_contact(ParticleContact &contact, unsigned i)
+{
+    if (effective_mass[i] == 0)
+        return;
+
+    real impulse = (target_velocity[i] - contact.calculate_separating_velocity()) * effective_mass[i];
+
+    // contacts can only push, so the total impulse is clamped rather than each step
+    real total = accumulated_impulse[i] + impulse;
+    if (total < 0)
+        total = 0;
+    impulse = total - accumulated_impulse[i];
+    accumulated_impulse[i] = total;
+
+    if (impulse != 0)
+        apply_impulse(contact, impulse);
+}
+
+void ParticleContactSolver::sweep(ParticleContact *contact_array, unsigned num_contacts, JobPool *pool)
+{
+    if (!pool || pool->get_thread_count() == 1)
+    {
+        for (unsigned i = 0; i < num_contacts; i++)
+            solve_contact(contact_array[i], i);
+        return;
+    }
+
+    for (unsigned batch = 0; batch < colouring.get_batch_count(); batch++)
+    {
+        const unsigned *contacts = colouring.begin(batch);
+        const unsigned count = colouring.end(batch) - contacts;
+
+        if (!colouring.is_parallel(batch))
+        {
+            for (unsigned i = 0; i < count; i++)
+                solve_contact(contact_array[contacts[i]], contacts[i]);
+            continue;
+        }
+
+        pool->parallel_for(count, 256, [this, contact_array, contacts](unsigned begin, unsigned end, unsigned thread)
+                           {
+            for (unsigned i = begin; i < end; i++)
+                solve_contact(contact_array[contacts[i]], contacts[i]); });
+    }
+}
+
+void ParticleContactSolver::solve_contacts(ParticleContact *contact_array, unsigned num_contacts, real duration, JobPool *pool)
+{
+    effective_mass.resize(num_contacts);
+    target_velocity.resize(num_contacts);
+    accumulated_impulse.resize(num_contacts);
+
+    // targets come from the velocities before any impulse, the same bounce and resting contact rules as resolve_velocity
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        ParticleContact &contact = contact_array[i];
+
+        real total_inverse_mass = contact.particle[0]->get_inverse_mass();
+        if (contact.particle[1])
+            total_inverse_mass += contact.particle[1]->get_inverse_mass();
+        effective_mass[i] = total_inverse_mass > 0 ? 1 / total_inverse_mass : 0;
+
+        real separating_velocity = contact.calculate_separating_velocity();
+        real target = 0;
+        if (separating_velocity < 0)
+        {
+            target = -separating_velocity * contact.restitution;
+
+            Vector3 accel_caused_velocity = contact.particle[0]->get_acceleration();
+            if (contact.particle[1])
+                accel_caused_velocity -= contact.particle[1]->get_acceleration();
+            real accel_caused_sep_velocity = accel_caused_velocity * contact.contact_normal * duration;
+            if (accel_caused_sep_velocity < 0)
+            {
+                target += contact.restitution * accel_caused_sep_velocity;
+                if (target < 0)
+                    target = 0;
+            }
+        }
+        target_velocity[i] = target;
+        accumulated_impulse[i] = 0;
+    }
+
+    // a pair with a rod and a collision between them, or two scenery contacts, would share one impulse between both
+    current_impulses.clear();
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        ParticleContact &contact = contact_array[i];
+        if (!contact.particle[1])
+            continue;
+
+        Vector3 normal;
+        WarmStart &current = current_impulses.insert({make_key(contact, normal), {0, normal, 0}}).first->second;
+        current.count++;
+    }
+
+    if (warm_start_factor > 0)
+    {
+        for (unsigned i = 0; i < num_contacts; i++)
+        {
+            ParticleContact &contact = contact_array[i];
+            if (!contact.particle[1])
+                continue;
+
+            Vector3 normal;
+            ContactKey key = make_key(contact, normal);
+            WarmStarts::const_iterator previous = previous_impulses.find(key);
+            if (previous == previous_impulses.end() || previous->second.count != 1 || current_impulses[key].count != 1)
+                continue;
+            // a rod flips its normal when it goes from stretched to compressed, that impulse no longer applies
+            if (previous->second.normal * normal <= 0)
+                continue;
+
+            accumulated_impulse[i] = previous->second.impulse * warm_start_factor;
+            apply_impulse(contact, accumulated_impulse[i]);
+        }
+    }
+
+    // colouring reuses the neighbour groups the position sweep needs anyway
+    neighbours.build(contact_array, num_contacts);
+    if (pool && pool->get_thread_count() > 1)
+        colouring.build(neighbours, num_contacts);
+    for (unsigned i = 0; i < sweeps; i++)
+    {
+        sweep(contact_array, num_contacts, pool);
+    }
+
+    // one position sweep, pushing each correction on to the neighbours so chains dont overshoot
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        Vector3 movement[2];
+        contact_array[i].resolve_interpenetration(duration, movement);
+
+        neighbours.gather(i, touched);
+        for (std::vector<unsigned>::iterator t = touched.begin(); t != touched.end(); t++)
+        {
+            if (*t != i)
+                update_penetration(contact_array[*t], contact_array[i], movement);
+        }
+    }
+
+    for (unsigned i = 0; i < num_contacts; i++)
+    {
+        ParticleContact &contact = contact_array[i];
+        if (!contact.particle[1])
+            continue;
+
+        Vector3 normal;
+        WarmStart &current = current_impulses[make_key(contact, normal)];
+        current.impulse = accumulated_impulse[i];
+        current.normal = normal;
+    }
+    previous_impulses.swap(current_impulses);
+}
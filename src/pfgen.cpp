@@ -1,9 +1,24 @@
 #include "gabbyphysics/pfgen.h"
+#include "gabbyphysics/helper.h"
+#include "gabbyphysics/simd.h"
+
+#include "algorithm"
+#include "typeinfo"
 
 using namespace gabbyphysics;
 
+ParticleForceRegistry::ParticleForceRegistry() : mode(VIRTUAL), batches_dirty(true)
+{
+}
+
 void ParticleForceRegistry::update_forces(real duration)
 {
+    if (mode == BATCHED)
+    {
+        update_batches(duration, 0);
+        return;
+    }
+
     Registry::iterator i = registrations.begin();
     for (; i != registrations.end(); i++)
     {
@@ -11,12 +26,710 @@ void ParticleForceRegistry::update_forces(real duration)
     }
 }
 
-void ParticleForceRegistry::add(Particle *particle, ParticleForceGenerator *fg)
+void ParticleForceRegistry::update_forces(real duration, JobPool *pool)
+{
+    if (mode == BATCHED)
+    {
+        update_batches(duration, pool);
+        return;
+    }
+
+    if (!pool || pool->get_thread_count() == 1)
+    {
+        update_forces(duration);
+        return;
+    }
+
+    // each range owns whole particles and runs their registrations in registration order
+    pool->parallel_for(registered_particles.size(), 256, [this, duration](unsigned begin, unsigned end, unsigned thread)
+                       {
+        for (unsigned p = begin; p < end; p++)
+        {
+            Particle *particle = registered_particles[p].particle;
+            for (Handle h = registered_particles[p].first; h != INVALID_HANDLE;)
+            {
+                ParticleForceRegistration &registration = get_registration(h);
+                registration.fg->update_force(particle, duration);
+                h = registration.next;
+            }
+        } });
+}
+
+void ParticleForceRegistry::clear()
+{
+    registrations.clear();
+    slots.clear();
+    free_handles.clear();
+    registered_particles.clear();
+    particle_index.clear();
+    batches_dirty = true;
+}
+
+void ParticleForceRegistry::link(ParticleForceRegistration &registration)
 {
+    registration.next = INVALID_HANDLE;
+
+    std::unordered_map<const Particle *, unsigned>::iterator found = particle_index.find(registration.particle);
+    if (found == particle_index.end())
+    {
+        particle_index[registration.particle] = registered_particles.size();
+
+        ParticleRegistrations entry;
+        entry.particle = registration.particle;
+        entry.first = registration.handle;
+        entry.last = registration.handle;
+        registered_particles.push_back(entry);
+
+        registration.previous = INVALID_HANDLE;
+        return;
+    }
+
+    ParticleRegistrations &entry = registered_particles[found->second];
+    registration.previous = entry.last;
+    get_registration(entry.last).next = registration.handle;
+    entry.last = registration.handle;
+}
+
+void ParticleForceRegistry::unlink(ParticleForceRegistration &registration)
+{
+    std::unordered_map<const Particle *, unsigned>::iterator found = particle_index.find(registration.particle);
+    ParticleRegistrations &entry = registered_particles[found->second];
+
+    if (registration.previous != INVALID_HANDLE)
+        get_registration(registration.previous).next = registration.next;
+    else
+        entry.first = registration.next;
+
+    if (registration.next != INVALID_HANDLE)
+        get_registration(registration.next).previous = registration.previous;
+    else
+        entry.last = registration.previous;
+
+    // the particle's last registration is gone, the last particle takes its place
+    if (entry.first == INVALID_HANDLE)
+    {
+        unsigned index = found->second;
+        particle_index.erase(found);
+        if (index + 1 < registered_particles.size())
+            particle_index[registered_particles.back().particle] = index;
+        swap_and_pop(registered_particles, index);
+    }
+}
+
+ParticleForceRegistry::Handle ParticleForceRegistry::add(Particle *particle, ParticleForceGenerator *fg)
+{
+    Handle handle;
+    if (!free_handles.empty())
+    {
+        // same entry, next generation
+        Handle freed = free_handles.back();
+        free_handles.pop_back();
+        handle = (freed & HANDLE_INDEX_MASK) | ((freed & ~HANDLE_INDEX_MASK) + (1u << HANDLE_INDEX_BITS));
+        // the last entry never goes round to INVALID_HANDLE
+        if (handle == INVALID_HANDLE)
+            handle = freed & HANDLE_INDEX_MASK;
+        slots[handle & HANDLE_INDEX_MASK] = registrations.size();
+    }
+    else
+    {
+        handle = slots.size();
+        slots.push_back(registrations.size());
+    }
+
     ParticleForceRegistry::ParticleForceRegistration registration;
     registration.particle = particle;
     registration.fg = fg;
+    registration.handle = handle;
     registrations.push_back(registration);
+    link(registrations.back());
+
+    if (mode == BATCHED && !batches_dirty)
+        batch_registration(registrations.back());
+    else
+        batches_dirty = true;
+
+    return handle;
+}
+
+void ParticleForceRegistry::remove(Handle handle)
+{
+    if (!is_valid(handle))
+        return;
+
+    ParticleForceRegistration &registration = get_registration(handle);
+    unlink(registration);
+
+    if (mode == BATCHED && !batches_dirty)
+        unbatch_registration(registration);
+    else
+        batches_dirty = true;
+
+    unsigned index = slots[handle & HANDLE_INDEX_MASK];
+    slots[registrations.back().handle & HANDLE_INDEX_MASK] = index;
+    swap_and_pop(registrations, index);
+
+    slots[handle & HANDLE_INDEX_MASK] = INVALID_HANDLE;
+    free_handles.push_back(handle);
+}
+
+void ParticleForceRegistry::remove(Particle *particle, ParticleForceGenerator *fg)
+{
+    std::unordered_map<const Particle *, unsigned>::iterator found = particle_index.find(particle);
+    if (found == particle_index.end())
+        return;
+
+    for (Handle h = registered_particles[found->second].first; h != INVALID_HANDLE; h = get_registration(h).next)
+    {
+        if (get_registration(h).fg == fg)
+        {
+            remove(h);
+            return;
+        }
+    }
+}
+
+void ParticleForceRegistry::remove_particle(Particle *particle)
+{
+    std::unordered_map<const Particle *, unsigned>::iterator found = particle_index.find(particle);
+    if (found == particle_index.end())
+        return;
+
+    // removing the last registration drops the particle's entry, so keep taking the first until then
+    Handle h = registered_particles[found->second].first;
+    while (h != INVALID_HANDLE)
+    {
+        Handle next = get_registration(h).next;
+        remove(h);
+        h = next;
+    }
+}
+
+bool ParticleForceRegistry::is_valid(Handle handle) const
+{
+    // a reused entry points at a registration holding a newer generation of the handle
+    unsigned index = handle & HANDLE_INDEX_MASK;
+    return index < slots.size() && slots[index] != INVALID_HANDLE && registrations[slots[index]].handle == handle;
+}
+
+unsigned ParticleForceRegistry::size() const
+{
+    return registrations.size();
+}
+
+void ParticleForceRegistry::set_mode(Mode mode)
+{
+    ParticleForceRegistry::mode = mode;
+}
+
+ParticleForceRegistry::Mode ParticleForceRegistry::get_mode() const
+{
+    return mode;
+}
+
+// batches are processed this many registrations at a time so the gathered inputs stay on the stack
+// a multiple of every simd width, lanes past the end of a batch are zero filled and thrown away
+const static unsigned FORCE_BLOCK = 256;
+
+static unsigned block_lanes(real *const *inputs, unsigned num_inputs, unsigned count)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    unsigned lanes = (count + width - 1) / width * width;
+    for (unsigned n = 0; n < num_inputs; n++)
+        std::fill(inputs[n] + count, inputs[n] + lanes, 0);
+    return lanes;
+}
+
+void ParticleForceRegistry::ForceBatch::add(Particle *particle, Handle handle)
+{
+    particles.push_back(particle);
+    handles.push_back(handle);
+    force_x.push_back(0);
+    force_y.push_back(0);
+    force_z.push_back(0);
+    stores.push_back(0);
+    slots.push_back(0);
+}
+
+void ParticleForceRegistry::ForceBatch::clear()
+{
+    particles.clear();
+    handles.clear();
+    force_x.clear();
+    force_y.clear();
+    force_z.clear();
+    stores.clear();
+    slots.clear();
+}
+
+ParticleForceRegistry::Handle ParticleForceRegistry::ForceBatch::remove(unsigned index)
+{
+    swap_and_pop(particles, index);
+    swap_and_pop(handles, index);
+    swap_and_pop(force_x, index);
+    swap_and_pop(force_y, index);
+    swap_and_pop(force_z, index);
+    swap_and_pop(stores, index);
+    swap_and_pop(slots, index);
+    return index < handles.size() ? handles[index] : INVALID_HANDLE;
+}
+
+void ParticleForceRegistry::GravityBatch::clear()
+{
+    ForceBatch::clear();
+    gravity_x.clear();
+    gravity_y.clear();
+    gravity_z.clear();
+}
+
+ParticleForceRegistry::Handle ParticleForceRegistry::GravityBatch::remove(unsigned index)
+{
+    swap_and_pop(gravity_x, index);
+    swap_and_pop(gravity_y, index);
+    swap_and_pop(gravity_z, index);
+    return ForceBatch::remove(index);
+}
+
+void ParticleForceRegistry::DragBatch::clear()
+{
+    ForceBatch::clear();
+    k1.clear();
+    k2.clear();
+}
+
+ParticleForceRegistry::Handle ParticleForceRegistry::DragBatch::remove(unsigned index)
+{
+    swap_and_pop(k1, index);
+    swap_and_pop(k2, index);
+    return ForceBatch::remove(index);
+}
+
+void ParticleForceRegistry::SpringBatch::clear()
+{
+    ForceBatch::clear();
+    others.clear();
+    anchors.clear();
+    spring_constant.clear();
+    rest_length.clear();
+}
+
+ParticleForceRegistry::Handle ParticleForceRegistry::SpringBatch::remove(unsigned index)
+{
+    swap_and_pop(others, index);
+    swap_and_pop(anchors, index);
+    swap_and_pop(spring_constant, index);
+    swap_and_pop(rest_length, index);
+    return ForceBatch::remove(index);
+}
+
+void ParticleForceRegistry::BuoyancyBatch::clear()
+{
+    ForceBatch::clear();
+    max_depth.clear();
+    volume.clear();
+    liquid_height.clear();
+    liquid_density.clear();
+}
+
+ParticleForceRegistry::Handle ParticleForceRegistry::BuoyancyBatch::remove(unsigned index)
+{
+    swap_and_pop(max_depth, index);
+    swap_and_pop(volume, index);
+    swap_and_pop(liquid_height, index);
+    swap_and_pop(liquid_density, index);
+    return ForceBatch::remove(index);
+}
+
+ParticleStore &ParticleForceRegistry::ForceBatch::locate(unsigned i)
+{
+    ParticleStore *store = particles[i]->get_store();
+    stores[i] = store;
+    slots[i] = store->get_slot(particles[i]->get_handle());
+    return *store;
+}
+
+void ParticleForceRegistry::ForceBatch::apply() const
+{
+    for (unsigned i = 0; i < particles.size(); i++)
+    {
+        ParticleStore &store = *stores[i];
+        unsigned slot = slots[i];
+        store.force_x[slot] += force_x[i];
+        store.force_y[slot] += force_y[i];
+        store.force_z[slot] += force_z[i];
+    }
+}
+
+void ParticleForceRegistry::ForceBatch::store(unsigned begin, unsigned count, const real *x, const real *y, const real *z)
+{
+    std::copy(x, x + count, force_x.begin() + begin);
+    std::copy(y, y + count, force_y.begin() + begin);
+    std::copy(z, z + count, force_z.begin() + begin);
+}
+
+void ParticleForceRegistry::GravityBatch::compute(unsigned begin, unsigned end)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+
+    for (; begin < end; begin += FORCE_BLOCK)
+    {
+        unsigned count = end - begin < FORCE_BLOCK ? end - begin : FORCE_BLOCK;
+
+        real w[FORCE_BLOCK], gx[FORCE_BLOCK], gy[FORCE_BLOCK], gz[FORCE_BLOCK];
+        for (unsigned i = 0; i < count; i++)
+        {
+            w[i] = locate(begin + i).inverse_mass[slots[begin + i]];
+            gx[i] = gravity_x[begin + i];
+            gy[i] = gravity_y[begin + i];
+            gz[i] = gravity_z[begin + i];
+        }
+        real *inputs[4] = {w, gx, gy, gz};
+        unsigned lanes = block_lanes(inputs, 4, count);
+
+        real fx[FORCE_BLOCK], fy[FORCE_BLOCK], fz[FORCE_BLOCK];
+        for (unsigned i = 0; i < lanes; i += width)
+        {
+            // infinite masses get no force, same as has_finite_mass in ParticleGravity
+            realv inverse_mass = realv::load(w + i);
+            realv finite = realv::select_greater(inverse_mass, zero, one, zero);
+            realv mass = finite / realv::select_greater(inverse_mass, zero, inverse_mass, one);
+            (realv::load(gx + i) * mass).store(fx + i);
+            (realv::load(gy + i) * mass).store(fy + i);
+            (realv::load(gz + i) * mass).store(fz + i);
+        }
+        store(begin, count, fx, fy, fz);
+    }
+}
+
+void ParticleForceRegistry::DragBatch::compute(unsigned begin, unsigned end)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+
+    for (; begin < end; begin += FORCE_BLOCK)
+    {
+        unsigned count = end - begin < FORCE_BLOCK ? end - begin : FORCE_BLOCK;
+
+        real vx[FORCE_BLOCK], vy[FORCE_BLOCK], vz[FORCE_BLOCK], a[FORCE_BLOCK], b[FORCE_BLOCK];
+        for (unsigned i = 0; i < count; i++)
+        {
+            ParticleStore &store = locate(begin + i);
+            unsigned slot = slots[begin + i];
+            vx[i] = store.velocity_x[slot];
+            vy[i] = store.velocity_y[slot];
+            vz[i] = store.velocity_z[slot];
+            a[i] = k1[begin + i];
+            b[i] = k2[begin + i];
+        }
+        real *inputs[5] = {vx, vy, vz, a, b};
+        unsigned lanes = block_lanes(inputs, 5, count);
+
+        real fx[FORCE_BLOCK], fy[FORCE_BLOCK], fz[FORCE_BLOCK];
+        for (unsigned i = 0; i < lanes; i += width)
+        {
+            realv x = realv::load(vx + i), y = realv::load(vy + i), z = realv::load(vz + i);
+            realv speed = (x * x + y * y + z * z).sqrt();
+            realv drag_coeff = realv::load(a + i) * speed + realv::load(b + i) * speed * speed;
+            // drag along -velocity / speed, nothing when still
+            realv scale = zero - drag_coeff / realv::select_greater(speed, zero, speed, one);
+            (x * scale).store(fx + i);
+            (y * scale).store(fy + i);
+            (z * scale).store(fz + i);
+        }
+        store(begin, count, fx, fy, fz);
+    }
+}
+
+void ParticleForceRegistry::SpringBatch::gather(unsigned begin, unsigned count, real *x, real *y, real *z, real *k, real *rest)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        ParticleStore &store = locate(begin + i);
+        unsigned slot = slots[begin + i];
+        Vector3 other = others[begin + i] ? others[begin + i]->get_position() : *anchors[begin + i];
+        x[i] = store.position_x[slot] - other.x;
+        y[i] = store.position_y[slot] - other.y;
+        z[i] = store.position_z[slot] - other.z;
+        k[i] = spring_constant[begin + i];
+        rest[i] = rest_length[begin + i];
+    }
+}
+
+void ParticleForceRegistry::SpringBatch::compute(unsigned begin, unsigned end)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+
+    for (; begin < end; begin += FORCE_BLOCK)
+    {
+        unsigned count = end - begin < FORCE_BLOCK ? end - begin : FORCE_BLOCK;
+
+        real dx[FORCE_BLOCK], dy[FORCE_BLOCK], dz[FORCE_BLOCK], k[FORCE_BLOCK], rest[FORCE_BLOCK];
+        gather(begin, count, dx, dy, dz, k, rest);
+        real *inputs[5] = {dx, dy, dz, k, rest};
+        unsigned lanes = block_lanes(inputs, 5, count);
+
+        real fx[FORCE_BLOCK], fy[FORCE_BLOCK], fz[FORCE_BLOCK];
+        for (unsigned i = 0; i < lanes; i += width)
+        {
+            realv x = realv::load(dx + i), y = realv::load(dy + i), z = realv::load(dz + i);
+            realv length = (x * x + y * y + z * z).sqrt();
+            realv stretch = length - realv::load(rest + i);
+            realv magnitude = realv::select_greater(stretch, zero, stretch, zero - stretch) * realv::load(k + i);
+            // a zero offset has no direction and pushes nothing, like Vector3::normalize
+            realv scale = realv::select_greater(length, zero, zero - magnitude / realv::select_greater(length, zero, length, one), zero);
+            (x * scale).store(fx + i);
+            (y * scale).store(fy + i);
+            (z * scale).store(fz + i);
+        }
+        store(begin, count, fx, fy, fz);
+    }
+}
+
+void ParticleForceRegistry::BungeeBatch::compute(unsigned begin, unsigned end)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+
+    for (; begin < end; begin += FORCE_BLOCK)
+    {
+        unsigned count = end - begin < FORCE_BLOCK ? end - begin : FORCE_BLOCK;
+
+        real dx[FORCE_BLOCK], dy[FORCE_BLOCK], dz[FORCE_BLOCK], k[FORCE_BLOCK], rest[FORCE_BLOCK];
+        gather(begin, count, dx, dy, dz, k, rest);
+        real *inputs[5] = {dx, dy, dz, k, rest};
+        unsigned lanes = block_lanes(inputs, 5, count);
+
+        real fx[FORCE_BLOCK], fy[FORCE_BLOCK], fz[FORCE_BLOCK];
+        for (unsigned i = 0; i < lanes; i += width)
+        {
+            realv x = realv::load(dx + i), y = realv::load(dy + i), z = realv::load(dz + i);
+            realv length = (x * x + y * y + z * z).sqrt();
+            realv stretch = length - realv::load(rest + i);
+            // slack bungees pull nothing
+            realv pull = zero - realv::load(k + i) * stretch / realv::select_greater(length, zero, length, one);
+            realv scale = realv::select_greater(stretch, zero, pull, zero);
+            (x * scale).store(fx + i);
+            (y * scale).store(fy + i);
+            (z * scale).store(fz + i);
+        }
+        store(begin, count, fx, fy, fz);
+    }
+}
+
+void ParticleForceRegistry::BuoyancyBatch::compute(unsigned begin, unsigned end)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv two = realv::broadcast(2);
+
+    for (; begin < end; begin += FORCE_BLOCK)
+    {
+        unsigned count = end - begin < FORCE_BLOCK ? end - begin : FORCE_BLOCK;
+
+        real depth[FORCE_BLOCK], max[FORCE_BLOCK], v[FORCE_BLOCK], height[FORCE_BLOCK], density[FORCE_BLOCK];
+        for (unsigned i = 0; i < count; i++)
+        {
+            depth[i] = locate(begin + i).position_y[slots[begin + i]];
+            max[i] = max_depth[begin + i];
+            v[i] = volume[begin + i];
+            height[i] = liquid_height[begin + i];
+            density[i] = liquid_density[begin + i];
+        }
+        real *inputs[5] = {depth, max, v, height, density};
+        unsigned lanes = block_lanes(inputs, 5, count);
+
+        real fx[FORCE_BLOCK], fy[FORCE_BLOCK], fz[FORCE_BLOCK];
+        for (unsigned i = 0; i < lanes; i += width)
+        {
+            realv d = realv::load(depth + i), m = realv::load(max + i), h = realv::load(height + i);
+            realv full = realv::load(density + i) * realv::load(v + i);
+
+            // same three cases as ParticleBuoyancy: out of the liquid, fully submerged, partially submerged
+            realv partial = full * (d - m - h) / two * m;
+            realv submerged = realv::select_greater(d, h - m, partial, full);
+            realv force = realv::select_greater(h + m, d, submerged, zero);
+            zero.store(fx + i);
+            force.store(fy + i);
+            zero.store(fz + i);
+        }
+        store(begin, count, fx, fy, fz);
+    }
+}
+
+void ParticleForceRegistry::batch_registration(ParticleForceRegistration &registration)
+{
+    // exact types only, a subclass may override update_force
+    const std::type_info &type = typeid(*registration.fg);
+    if (type == typeid(ParticleGravity))
+    {
+        const ParticleGravity *fg = static_cast<const ParticleGravity *>(registration.fg);
+        registration.batch = GRAVITY;
+        registration.batch_index = gravity.size();
+        gravity.add(registration.particle, registration.handle);
+        gravity.gravity_x.push_back(fg->gravity.x);
+        gravity.gravity_y.push_back(fg->gravity.y);
+        gravity.gravity_z.push_back(fg->gravity.z);
+    }
+    else if (type == typeid(ParticleDrag))
+    {
+        const ParticleDrag *fg = static_cast<const ParticleDrag *>(registration.fg);
+        registration.batch = DRAG;
+        registration.batch_index = drag.size();
+        drag.add(registration.particle, registration.handle);
+        drag.k1.push_back(fg->k1);
+        drag.k2.push_back(fg->k2);
+    }
+    else if (type == typeid(ParticleSpring))
+    {
+        const ParticleSpring *fg = static_cast<const ParticleSpring *>(registration.fg);
+        registration.batch = SPRING;
+        registration.batch_index = springs.size();
+        springs.add(registration.particle, registration.handle);
+        springs.others.push_back(fg->other);
+        springs.anchors.push_back(0);
+        springs.spring_constant.push_back(fg->spring_constant);
+        springs.rest_length.push_back(fg->rest_length);
+    }
+    else if (type == typeid(ParticleBungee))
+    {
+        const ParticleBungee *fg = static_cast<const ParticleBungee *>(registration.fg);
+        registration.batch = BUNGEE;
+        registration.batch_index = bungees.size();
+        bungees.add(registration.particle, registration.handle);
+        bungees.others.push_back(fg->other);
+        bungees.anchors.push_back(0);
+        bungees.spring_constant.push_back(fg->spring_constant);
+        bungees.rest_length.push_back(fg->rest_length);
+    }
+    else if (type == typeid(ParticleAnchoredSpring))
+    {
+        const ParticleAnchoredSpring *fg = static_cast<const ParticleAnchoredSpring *>(registration.fg);
+        registration.batch = ANCHORED_SPRING;
+        registration.batch_index = anchored_springs.size();
+        anchored_springs.add(registration.particle, registration.handle);
+        anchored_springs.others.push_back(0);
+        anchored_springs.anchors.push_back(fg->anchor);
+        anchored_springs.spring_constant.push_back(fg->spring_constant);
+        anchored_springs.rest_length.push_back(fg->rest_length);
+    }
+    else if (type == typeid(ParticleBuoyancy))
+    {
+        const ParticleBuoyancy *fg = static_cast<const ParticleBuoyancy *>(registration.fg);
+        registration.batch = BUOYANCY;
+        registration.batch_index = buoyancy.size();
+        buoyancy.add(registration.particle, registration.handle);
+        buoyancy.max_depth.push_back(fg->max_depth);
+        buoyancy.volume.push_back(fg->volume);
+        buoyancy.liquid_height.push_back(fg->liquid_height);
+        buoyancy.liquid_density.push_back(fg->liquid_density);
+    }
+    else
+    {
+        registration.batch = OTHER;
+        registration.batch_index = others.size();
+        others.push_back(registration.handle);
+    }
+}
+
+void ParticleForceRegistry::unbatch_registration(const ParticleForceRegistration &registration)
+{
+    const unsigned index = registration.batch_index;
+
+    Handle moved = INVALID_HANDLE;
+    switch (registration.batch)
+    {
+    case GRAVITY:
+        moved = gravity.remove(index);
+        break;
+    case DRAG:
+        moved = drag.remove(index);
+        break;
+    case SPRING:
+        moved = springs.remove(index);
+        break;
+    case ANCHORED_SPRING:
+        moved = anchored_springs.remove(index);
+        break;
+    case BUNGEE:
+        moved = bungees.remove(index);
+        break;
+    case BUOYANCY:
+        moved = buoyancy.remove(index);
+        break;
+    case OTHER:
+        swap_and_pop(others, index);
+        moved = index < others.size() ? others[index] : INVALID_HANDLE;
+        break;
+    }
+
+    if (moved != INVALID_HANDLE)
+        get_registration(moved).batch_index = index;
+}
+
+void ParticleForceRegistry::build_batches()
+{
+    gravity.clear();
+    drag.clear();
+    springs.clear();
+    anchored_springs.clear();
+    bungees.clear();
+    buoyancy.clear();
+    others.clear();
+
+    for (Registry::iterator i = registrations.begin(); i != registrations.end(); i++)
+        batch_registration(*i);
+    batches_dirty = false;
+}
+
+void ParticleForceRegistry::update_batches(real duration, JobPool *pool)
+{
+    if (batches_dirty)
+        build_batches();
+
+    // forces only land in each batch's own arrays so any split across threads is safe
+    if (pool && pool->get_thread_count() > 1)
+    {
+        pool->parallel_for(gravity.size(), 4096, [this](unsigned begin, unsigned end, unsigned thread)
+                           { gravity.compute(begin, end); });
+        pool->parallel_for(drag.size(), 4096, [this](unsigned begin, unsigned end, unsigned thread)
+                           { drag.compute(begin, end); });
+        pool->parallel_for(springs.size(), 4096, [this](unsigned begin, unsigned end, unsigned thread)
+                           { springs.compute(begin, end); });
+        pool->parallel_for(anchored_springs.size(), 4096, [this](unsigned begin, unsigned end, unsigned thread)
+                           { anchored_springs.compute(begin, end); });
+        pool->parallel_for(bungees.size(), 4096, [this](unsigned begin, unsigned end, unsigned thread)
+                           { bungees.compute(begin, end); });
+        pool->parallel_for(buoyancy.size(), 4096, [this](unsigned begin, unsigned end, unsigned thread)
+                           { buoyancy.compute(begin, end); });
+    }
+    else
+    {
+        gravity.compute(0, gravity.size());
+        drag.compute(0, drag.size());
+        springs.compute(0, springs.size());
+        anchored_springs.compute(0, anchored_springs.size());
+        bungees.compute(0, bungees.size());
+        buoyancy.compute(0, buoyancy.size());
+    }
+
+    // several batches can push the same particle so adding stays on this thread
+    gravity.apply();
+    drag.apply();
+    springs.apply();
+    anchored_springs.apply();
+    bungees.apply();
+    buoyancy.apply();
+
+    for (std::vector<Handle>::iterator h = others.begin(); h != others.end(); h++)
+    {
+        ParticleForceRegistration &registration = get_registration(*h);
+        registration.fg->update_force(registration.particle, duration);
+    }
 }
 
 ParticleGravity::ParticleGravity(const Vector3 &gravity) : gravity(gravity)
@@ -104,7 +817,7 @@ void ParticleBungee::update_force(Particle *particle, real duration)
     magnitude = spring_constant * (rest_length - magnitude);
 
     force.normalize();
-    force *= -magnitude;
+    force *= magnitude;
     particle->add_force(force);
 }
 
@@ -132,3 +845,130 @@ void ParticleBuoyancy::update_force(Particle *particle, real duration)
     force.y = liquid_density * volume * (depth - max_depth - liquid_height) / 2 * max_depth;
     particle->add_force(force);
 }
+
+ParticleForceField::ParticleForceField() : mask(ALL_LAYERS)
+{
+}
+
+ParticleGravityField::ParticleGravityField(const Vector3 &gravity) : gravity(gravity)
+{
+}
+
+void ParticleGravityField::compute(ParticleFieldBlock &block, real duration) const
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+    const realv gx = realv::broadcast(gravity.x), gy = realv::broadcast(gravity.y), gz = realv::broadcast(gravity.z);
+
+    for (unsigned i = 0; i < block.lanes; i += width)
+    {
+        realv inverse_mass = realv::load(block.inverse_mass + i);
+        realv mass = realv::select_greater(inverse_mass, zero, one, zero) / realv::select_greater(inverse_mass, zero, inverse_mass, one);
+        (gx * mass).store(block.force_x + i);
+        (gy * mass).store(block.force_y + i);
+        (gz * mass).store(block.force_z + i);
+    }
+}
+
+ParticleDragField::ParticleDragField(real k1, real k2) : k1(k1), k2(k2)
+{
+}
+
+void ParticleDragField::compute(ParticleFieldBlock &block, real duration) const
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+    const realv a = realv::broadcast(k1), b = realv::broadcast(k2);
+
+    for (unsigned i = 0; i < block.lanes; i += width)
+    {
+        realv x = realv::load(block.velocity_x + i), y = realv::load(block.velocity_y + i), z = realv::load(block.velocity_z + i);
+        realv speed = (x * x + y * y + z * z).sqrt();
+        realv scale = zero - (a * speed + b * speed * speed) / realv::select_greater(speed, zero, speed, one);
+        (x * scale).store(block.force_x + i);
+        (y * scale).store(block.force_y + i);
+        (z * scale).store(block.force_z + i);
+    }
+}
+
+ParticleWindField::ParticleWindField(const Vector3 &velocity, real coefficient)
+    : velocity(velocity), coefficient(coefficient)
+{
+}
+
+void ParticleWindField::compute(ParticleFieldBlock &block, real duration) const
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv k = realv::broadcast(coefficient);
+    const realv wx = realv::broadcast(velocity.x), wy = realv::broadcast(velocity.y), wz = realv::broadcast(velocity.z);
+
+    for (unsigned i = 0; i < block.lanes; i += width)
+    {
+        ((wx - realv::load(block.velocity_x + i)) * k).store(block.force_x + i);
+        ((wy - realv::load(block.velocity_y + i)) * k).store(block.force_y + i);
+        ((wz - realv::load(block.velocity_z + i)) * k).store(block.force_z + i);
+    }
+}
+
+ParticleBuoyancyField::ParticleBuoyancyField(real max_depth, real volume, real liquid_height, real liquid_density)
+    : max_depth(max_depth), volume(volume), liquid_height(liquid_height), liquid_density(liquid_density)
+{
+}
+
+void ParticleBuoyancyField::compute(ParticleFieldBlock &block, real duration) const
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv m = realv::broadcast(max_depth), h = realv::broadcast(liquid_height);
+    const realv full = realv::broadcast(liquid_density * volume);
+    const realv surface = realv::broadcast(liquid_height + max_depth);
+    const realv bottom = realv::broadcast(liquid_height - max_depth);
+
+    for (unsigned i = 0; i < block.lanes; i += width)
+    {
+        // same three cases as ParticleBuoyancy: out of the liquid, fully submerged, partially submerged
+        realv depth = realv::load(block.position_y + i);
+        realv partial = full * (depth - m - h) / realv::broadcast(2) * m;
+        realv submerged = realv::select_greater(depth, bottom, partial, full);
+        zero.store(block.force_x + i);
+        realv::select_greater(surface, depth, submerged, zero).store(block.force_y + i);
+        zero.store(block.force_z + i);
+    }
+}
+
+ParticleAttractorField::ParticleAttractorField(const Vector3 &centre, real strength, real radius, real softening)
+    : centre(centre), strength(strength), radius(radius), softening(softening)
+{
+}
+
+void ParticleAttractorField::compute(ParticleFieldBlock &block, real duration) const
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv zero = realv::broadcast(0);
+    const realv one = realv::broadcast(1);
+    const realv cx = realv::broadcast(centre.x), cy = realv::broadcast(centre.y), cz = realv::broadcast(centre.z);
+    const realv square_radius = realv::broadcast(radius * radius);
+    const realv square_softening = realv::broadcast(softening * softening);
+    const realv s = realv::broadcast(strength);
+
+    for (unsigned i = 0; i < block.lanes; i += width)
+    {
+        realv x = cx - realv::load(block.position_x + i);
+        realv y = cy - realv::load(block.position_y + i);
+        realv z = cz - realv::load(block.position_z + i);
+        realv square_distance = x * x + y * y + z * z;
+
+        realv inverse_mass = realv::load(block.inverse_mass + i);
+        realv mass = realv::select_greater(inverse_mass, zero, one, zero) / realv::select_greater(inverse_mass, zero, inverse_mass, one);
+
+        // strength * mass / d^2 along the unit offset, nothing outside the radius
+        realv softened = square_distance + square_softening;
+        realv scale = s * mass / (softened * softened.sqrt());
+        scale = realv::select_greater(square_radius, square_distance, scale, zero);
+        (x * scale).store(block.force_x + i);
+        (y * scale).store(block.force_y + i);
+        (z * scale).store(block.force_z + i);
+    }
+}
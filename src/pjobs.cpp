@@ -0,0 +1,157 @@
+#include "gabbyphysics/pjobs.h"
+
+using namespace gabbyphysics;
+
+#if GABBYPHYSICS_THREADS
+
+JobPool::JobPool(unsigned threads) : job(0), pending(0), generation(0), stopping(false)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    thread_count = threads == 0 ? 1 : threads;
+
+    queues.reset(new Queue[thread_count]);
+
+    // thread 0 is whoever calls parallel_for
+    for (unsigned i = 1; i < thread_count; i++)
+    {
+        workers.push_back(std::thread(&JobPool::worker_main, this, i));
+    }
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); w++)
+    {
+        w->join();
+    }
+}
+
+bool JobPool::pop(unsigned thread, Range &range)
+{
+    {
+        Queue &own = queues[thread];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.ranges.empty())
+        {
+            range = own.ranges.back();
+            own.ranges.pop_back();
+            return true;
+        }
+    }
+
+    for (unsigned i = 1; i < thread_count; i++)
+    {
+        Queue &victim = queues[(thread + i) % thread_count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.ranges.empty())
+        {
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobPool::run(unsigned thread)
+{
+    Range range;
+    while (pop(thread, range))
+    {
+        (*job)(range.begin, range.end, thread);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void JobPool::worker_main(unsigned thread)
+{
+    unsigned seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake.wait(lock, [&]
+                      { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        run(thread);
+    }
+}
+
+void JobPool::parallel_for(unsigned count, unsigned chunk_size, const RangeJob &job)
+{
+    if (count == 0)
+        return;
+    if (chunk_size == 0)
+        chunk_size = 1;
+
+    if (thread_count == 1 || count <= chunk_size)
+    {
+        job(0, count, 0);
+        return;
+    }
+
+    JobPool::job = &job;
+    unsigned chunks = (count + chunk_size - 1) / chunk_size;
+    pending.store(chunks, std::memory_order_release);
+
+    // deal the ranges out round robin so every thread starts with local work
+    for (unsigned i = 0; i < chunks; i++)
+    {
+        Range range = {i * chunk_size, i * chunk_size + chunk_size};
+        if (range.end > count)
+            range.end = count;
+
+        Queue &queue = queues[i % thread_count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.ranges.push_back(range);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    run(0);
+    while (pending.load(std::memory_order_acquire) != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    JobPool::job = 0;
+}
+
+#else
+
+JobPool::JobPool(unsigned threads) : thread_count(1)
+{
+}
+
+JobPool::~JobPool()
+{
+}
+
+void JobPool::parallel_for(unsigned count, unsigned chunk_size, const RangeJob &job)
+{
+    if (count > 0)
+        job(0, count, 0);
+}
+
+#endif
+
+unsigned JobPool::get_thread_count() const
+{
+    return thread_count;
+}
@@ -10,6 +10,22 @@ real ParticleLink::current_length() const
     return relative_pos.magnitude();
 }
 
+// links write at most one contact
+static unsigned add_one_contact(const ParticleContactGenerator &generator, ParticleCompactContacts &contacts, unsigned limit)
+{
+    ParticleContact contact;
+    if (limit == 0 || generator.add_contact(&contact, 1) == 0)
+        return 0;
+
+    contacts.add(contact);
+    return 1;
+}
+
+unsigned ParticleLink::add_contacts(ParticleCompactContacts &contacts, unsigned limit) const
+{
+    return add_one_contact(*this, contacts, limit);
+}
+
 // acts as a collision detector to generate a 'collision' when two particles connected by a cable move farther apart than the cable length
 unsigned ParticleCable::add_contact(ParticleContact *contact, unsigned limit) const
 {
@@ -35,7 +51,7 @@ unsigned ParticleCable::add_contact(ParticleContact *contact, unsigned limit) co
 
 real ParticleRod::current_length() const
 {
-    return length;
+    return ParticleLink::current_length();
 }
 
 unsigned ParticleRod::add_contact(ParticleContact *contact, unsigned limit) const
@@ -75,6 +91,11 @@ real ParticleConstraint::current_length() const
     return relative_pos.magnitude();
 }
 
+unsigned ParticleConstraint::add_contacts(ParticleCompactContacts &contacts, unsigned limit) const
+{
+    return add_one_contact(*this, contacts, limit);
+}
+
 unsigned ParticleCableConstraint::add_contact(ParticleContact *contact, unsigned limit) const
 {
     real length = current_length();
@@ -0,0 +1,74 @@
+#include "gabbyphysics/psph.h"
+
+using namespace gabbyphysics;
+
+void SphNeighbours::for_each_range(JobPool *jobs, unsigned count, const JobPool::RangeJob &job)
+{
+    if (jobs)
+        jobs->parallel_for(count, CHUNK, job);
+    else if (count > 0)
+        job(0, count, 0);
+}
+
+void SphNeighbours::build(const ParticleStore &store, real radius, JobPool *jobs)
+{
+    const unsigned count = store.size();
+    const real *px = store.position_x.data(), *py = store.position_y.data(), *pz = store.position_z.data();
+
+    list_begin.resize(count);
+    list_count.resize(count);
+    chunk_indices.resize((count + CHUNK - 1) / CHUNK);
+    chunk_distances.resize(chunk_indices.size());
+
+    hash.set_cell_size(radius);
+    hash.build(px, py, pz, count);
+
+    const real square_radius = radius * radius;
+    for_each_range(jobs, count, [&](unsigned begin, unsigned end, unsigned)
+                   {
+        // a range without a pool covers every chunk, with one it is a single chunk
+        for (unsigned chunk = begin / CHUNK; chunk * CHUNK < end; chunk++)
+        {
+            std::vector<unsigned> &indices = chunk_indices[chunk];
+            std::vector<real> &distances = chunk_distances[chunk];
+            indices.clear();
+            distances.clear();
+
+            unsigned last = (chunk + 1) * CHUNK < end ? (chunk + 1) * CHUNK : end;
+            unsigned buckets[27];
+            for (unsigned i = chunk * CHUNK; i < last; i++)
+            {
+                list_begin[i] = indices.size();
+
+                unsigned num_buckets = hash.neighbour_buckets(px[i], py[i], pz[i], buckets);
+                for (unsigned b = 0; b < num_buckets; b++)
+                {
+                    for (const unsigned *j = hash.begin(buckets[b]); j != hash.end(buckets[b]); j++)
+                    {
+                        if (*j == i)
+                            continue;
+
+                        real dx = px[*j] - px[i], dy = py[*j] - py[i], dz = pz[*j] - pz[i];
+                        real square_distance = dx * dx + dy * dy + dz * dz;
+                        if (square_distance >= square_radius)
+                            continue;
+
+                        indices.push_back(*j);
+                        distances.push_back(real_sqrt(square_distance));
+                    }
+                }
+
+                list_count[i] = indices.size() - list_begin[i];
+            }
+        } });
+}
+
+Vector3 gabbyphysics::sph_coincident_direction(unsigned i, unsigned j)
+{
+    // seeded from the pair in index order and flipped for the other side, so the two pushes cancel
+    if (i > j)
+        return sph_coincident_direction(j, i) * -1;
+
+    Random random((unsigned long long)i << 32 | j);
+    return random.unit_vector();
+}
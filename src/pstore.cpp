@@ -0,0 +1,473 @@
+#include "gabbyphysics/pstore.h"
+#include "gabbyphysics/helper.h"
+#include "gabbyphysics/simd.h"
+
+#include "utility"
+
+using namespace gabbyphysics;
+
+ParticleStore::ParticleStore()
+{
+    layout.version = ParticleStoreLayout::VERSION;
+#if defined(GABBYPHYSICS_FIXED_POINT)
+    layout.precision = ParticleStoreLayout::FIXED;
+#elif defined(GABBYPHYSICS_DOUBLE_PRECISION)
+    layout.precision = ParticleStoreLayout::DOUBLE;
+#else
+    layout.precision = ParticleStoreLayout::FLOAT;
+#endif
+    layout.generation = 0;
+    layout.count = 0;
+    layout.position_x = layout.position_y = layout.position_z = 0;
+    layout.velocity_x = layout.velocity_y = layout.velocity_z = 0;
+    layout.handles = 0;
+    update_layout();
+}
+
+void ParticleStore::update_layout(bool reordered)
+{
+    if (!reordered && layout.count == size() &&
+        layout.position_x == position_x.data() && layout.position_y == position_y.data() && layout.position_z == position_z.data() &&
+        layout.velocity_x == velocity_x.data() && layout.velocity_y == velocity_y.data() && layout.velocity_z == velocity_z.data() &&
+        layout.handles == handles.data())
+        return;
+
+    layout.count = size();
+    layout.position_x = position_x.data();
+    layout.position_y = position_y.data();
+    layout.position_z = position_z.data();
+    layout.velocity_x = velocity_x.data();
+    layout.velocity_y = velocity_y.data();
+    layout.velocity_z = velocity_z.data();
+    layout.handles = handles.data();
+    layout.generation++;
+}
+
+const ParticleStoreLayout &ParticleStore::get_layout() const
+{
+    return layout;
+}
+
+// a thread's standalone store, left behind at thread exit while particles still own slots in it
+// e.g. globals destroyed after main's thread locals
+struct StandaloneStore
+{
+    ParticleStore *store;
+
+    StandaloneStore() : store(new ParticleStore()) {}
+    ~StandaloneStore()
+    {
+        if (store->size() == 0)
+            delete store;
+    }
+};
+
+ParticleStore &ParticleStore::get_standalone()
+{
+    thread_local StandaloneStore standalone;
+    return *standalone.store;
+}
+
+ParticleStore::Handle ParticleStore::create()
+{
+    unsigned slot = handles.size();
+
+    Handle handle;
+    if (!free_handles.empty())
+    {
+        // same entry, next generation
+        Handle freed = free_handles.back();
+        free_handles.pop_back();
+        handle = (freed & HANDLE_INDEX_MASK) | ((freed & ~HANDLE_INDEX_MASK) + (1u << HANDLE_INDEX_BITS));
+        // the last entry never goes round to INVALID_HANDLE
+        if (handle == INVALID_HANDLE)
+            handle = freed & HANDLE_INDEX_MASK;
+    }
+    else
+    {
+        handle = slots.size();
+        slots.push_back(slot);
+    }
+    slots[handle & HANDLE_INDEX_MASK] = slot;
+    handles.push_back(handle);
+
+    position_x.push_back(0);
+    position_y.push_back(0);
+    position_z.push_back(0);
+    velocity_x.push_back(0);
+    velocity_y.push_back(0);
+    velocity_z.push_back(0);
+    acceleration_x.push_back(0);
+    acceleration_y.push_back(0);
+    acceleration_z.push_back(0);
+    force_x.push_back(0);
+    force_y.push_back(0);
+    force_z.push_back(0);
+    damping.push_back(1);
+    inverse_mass.push_back(0);
+    layers.push_back(1);
+
+    update_layout();
+    return handle;
+}
+
+void ParticleStore::destroy(Handle handle)
+{
+    if (!is_valid(handle))
+        return;
+
+    unsigned slot = slots[handle & HANDLE_INDEX_MASK];
+    unsigned last = handles.size() - 1;
+
+    Handle moved = handles[last];
+    slots[moved & HANDLE_INDEX_MASK] = slot;
+    swap_and_pop(handles, slot);
+
+    swap_and_pop(position_x, slot);
+    swap_and_pop(position_y, slot);
+    swap_and_pop(position_z, slot);
+    swap_and_pop(velocity_x, slot);
+    swap_and_pop(velocity_y, slot);
+    swap_and_pop(velocity_z, slot);
+    swap_and_pop(acceleration_x, slot);
+    swap_and_pop(acceleration_y, slot);
+    swap_and_pop(acceleration_z, slot);
+    swap_and_pop(force_x, slot);
+    swap_and_pop(force_y, slot);
+    swap_and_pop(force_z, slot);
+    swap_and_pop(damping, slot);
+    swap_and_pop(inverse_mass, slot);
+    swap_and_pop(layers, slot);
+
+    slots[handle & HANDLE_INDEX_MASK] = INVALID_SLOT;
+    free_handles.push_back(handle);
+
+    // the last slot moved into the freed one
+    update_layout(true);
+}
+
+void ParticleStore::reserve(unsigned capacity)
+{
+    handles.reserve(capacity);
+    position_x.reserve(capacity);
+    position_y.reserve(capacity);
+    position_z.reserve(capacity);
+    velocity_x.reserve(capacity);
+    velocity_y.reserve(capacity);
+    velocity_z.reserve(capacity);
+    acceleration_x.reserve(capacity);
+    acceleration_y.reserve(capacity);
+    acceleration_z.reserve(capacity);
+    force_x.reserve(capacity);
+    force_y.reserve(capacity);
+    force_z.reserve(capacity);
+    damping.reserve(capacity);
+    inverse_mass.reserve(capacity);
+    layers.reserve(capacity);
+
+    update_layout();
+}
+
+void ParticleStore::clear()
+{
+    slots.clear();
+    handles.clear();
+    free_handles.clear();
+
+    position_x.clear();
+    position_y.clear();
+    position_z.clear();
+    velocity_x.clear();
+    velocity_y.clear();
+    velocity_z.clear();
+    acceleration_x.clear();
+    acceleration_y.clear();
+    acceleration_z.clear();
+    force_x.clear();
+    force_y.clear();
+    force_z.clear();
+    damping.clear();
+    inverse_mass.clear();
+    layers.clear();
+
+    update_layout();
+}
+
+unsigned ParticleStore::size() const
+{
+    return handles.size();
+}
+
+bool ParticleStore::is_valid(Handle handle) const
+{
+    return get_slot(handle) != INVALID_SLOT;
+}
+
+unsigned ParticleStore::get_slot(Handle handle) const
+{
+    // a reused entry points at a slot holding a newer generation of the handle
+    unsigned index = handle & HANDLE_INDEX_MASK;
+    if (index >= slots.size())
+        return INVALID_SLOT;
+    unsigned slot = slots[index];
+    return slot < handles.size() && handles[slot] == handle ? slot : INVALID_SLOT;
+}
+
+ParticleStore::Handle ParticleStore::get_handle(unsigned slot) const
+{
+    return handles[slot];
+}
+
+// the moved array goes into scratch and the two swap, so the old buffer is the next array's scratch
+template <typename T>
+static void permute_array(std::vector<T> &array, const std::vector<unsigned> &order, std::vector<T> &scratch)
+{
+    scratch.resize(array.size());
+    for (unsigned i = 0; i < order.size(); i++)
+        scratch[i] = array[order[i]];
+    array.swap(scratch);
+}
+
+void ParticleStore::permute(const std::vector<unsigned> &order)
+{
+    permute_array(position_x, order, permute_scratch);
+    permute_array(position_y, order, permute_scratch);
+    permute_array(position_z, order, permute_scratch);
+    permute_array(velocity_x, order, permute_scratch);
+    permute_array(velocity_y, order, permute_scratch);
+    permute_array(velocity_z, order, permute_scratch);
+    permute_array(acceleration_x, order, permute_scratch);
+    permute_array(acceleration_y, order, permute_scratch);
+    permute_array(acceleration_z, order, permute_scratch);
+    permute_array(force_x, order, permute_scratch);
+    permute_array(force_y, order, permute_scratch);
+    permute_array(force_z, order, permute_scratch);
+    permute_array(damping, order, permute_scratch);
+    permute_array(inverse_mass, order, permute_scratch);
+    permute_array(layers, order, sort_scratch);
+    permute_array(handles, order, sort_scratch);
+
+    for (unsigned slot = 0; slot < handles.size(); slot++)
+        slots[handles[slot] & HANDLE_INDEX_MASK] = slot;
+
+    update_layout(true);
+}
+
+// the low 10 bits of value moved to every third bit
+static unsigned spread_bits(unsigned value)
+{
+    value &= 0x3ff;
+    value = (value | value << 16) & 0x030000ff;
+    value = (value | value << 8) & 0x0300f00f;
+    value = (value | value << 4) & 0x030c30c3;
+    value = (value | value << 2) & 0x09249249;
+    return value;
+}
+
+// the cell along one axis clamped to the 1024 a key has room for, before converting so a huge or nan position
+// cant overflow the int, nan compares false both ways and lands in cell 0
+static unsigned sort_cell(real position, real inverse_cell_size)
+{
+    real cell = real_floor(position * inverse_cell_size);
+    if (!(cell > real(0)))
+        return 0;
+    if (cell > real(1023))
+        return 1023;
+    return (unsigned)(int)cell;
+}
+
+void ParticleStore::sort_spatially(real cell_size)
+{
+    const unsigned count = size();
+    const real inverse_cell_size = 1 / cell_size;
+
+    // cells past the first 1024 along an axis share the last one, particles out there still sort but less finely
+    sort_keys.resize(count);
+    bool sorted = true;
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned x = sort_cell(position_x[i], inverse_cell_size);
+        unsigned y = sort_cell(position_y[i], inverse_cell_size);
+        unsigned z = sort_cell(position_z[i], inverse_cell_size);
+        sort_keys[i] = spread_bits(x) | spread_bits(y) << 1 | spread_bits(z) << 2;
+        sorted = sorted && (i == 0 || sort_keys[i - 1] <= sort_keys[i]);
+    }
+    // particles that havent moved cells since the last sort dont need another
+    if (sorted)
+        return;
+
+    sort_order.resize(count);
+    sort_scratch.resize(count);
+    for (unsigned i = 0; i < count; i++)
+        sort_order[i] = i;
+
+    // lsd radix sort on 8 bit digits, each pass is stable so it keeps the order of the passes before it
+    std::vector<unsigned> *from = &sort_order, *to = &sort_scratch;
+    for (unsigned shift = 0; shift < 32; shift += 8)
+    {
+        unsigned starts[257] = {0};
+        for (unsigned i = 0; i < count; i++)
+            starts[((sort_keys[i] >> shift) & 0xff) + 1]++;
+
+        // a digit every key shares wouldnt move anything
+        if (starts[((sort_keys[0] >> shift) & 0xff) + 1] == count)
+            continue;
+
+        for (unsigned digit = 0; digit < 256; digit++)
+            starts[digit + 1] += starts[digit];
+        for (unsigned i = 0; i < count; i++)
+        {
+            unsigned slot = (*from)[i];
+            (*to)[starts[(sort_keys[slot] >> shift) & 0xff]++] = slot;
+        }
+        std::swap(from, to);
+    }
+
+    if (from != &sort_order)
+        sort_order.swap(sort_scratch);
+    permute(sort_order);
+}
+
+Vector3 ParticleStore::get_position(unsigned slot) const
+{
+    return Vector3(position_x[slot], position_y[slot], position_z[slot]);
+}
+
+void ParticleStore::set_position(unsigned slot, const Vector3 &position)
+{
+    position_x[slot] = position.x;
+    position_y[slot] = position.y;
+    position_z[slot] = position.z;
+}
+
+Vector3 ParticleStore::get_velocity(unsigned slot) const
+{
+    return Vector3(velocity_x[slot], velocity_y[slot], velocity_z[slot]);
+}
+
+void ParticleStore::set_velocity(unsigned slot, const Vector3 &velocity)
+{
+    velocity_x[slot] = velocity.x;
+    velocity_y[slot] = velocity.y;
+    velocity_z[slot] = velocity.z;
+}
+
+Vector3 ParticleStore::get_acceleration(unsigned slot) const
+{
+    return Vector3(acceleration_x[slot], acceleration_y[slot], acceleration_z[slot]);
+}
+
+void ParticleStore::set_acceleration(unsigned slot, const Vector3 &acceleration)
+{
+    acceleration_x[slot] = acceleration.x;
+    acceleration_y[slot] = acceleration.y;
+    acceleration_z[slot] = acceleration.z;
+}
+
+void ParticleStore::add_force(unsigned slot, const Vector3 &force)
+{
+    force_x[slot] += force.x;
+    force_y[slot] += force.y;
+    force_z[slot] += force.z;
+}
+
+// same steps as Particle::integrate, one component array at a time
+void ParticleStore::integrate(real duration, unsigned begin, unsigned end)
+{
+    if (duration == 0.0)
+        return;
+
+    real *px = position_x.data(), *py = position_y.data(), *pz = position_z.data();
+    real *vx = velocity_x.data(), *vy = velocity_y.data(), *vz = velocity_z.data();
+    const real *ax = acceleration_x.data(), *ay = acceleration_y.data(), *az = acceleration_z.data();
+    real *fx = force_x.data(), *fy = force_y.data(), *fz = force_z.data();
+    const real *d = damping.data(), *w = inverse_mass.data();
+
+    for (unsigned i = begin; i < end; i++)
+    {
+        px[i] += vx[i] * duration;
+        py[i] += vy[i] * duration;
+        pz[i] += vz[i] * duration;
+
+        real drag = real_pow(d[i], duration);
+        vx[i] = (vx[i] + (ax[i] + fx[i] * w[i]) * duration) * drag;
+        vy[i] = (vy[i] + (ay[i] + fy[i] * w[i]) * duration) * drag;
+        vz[i] = (vz[i] + (az[i] + fz[i] * w[i]) * duration) * drag;
+
+        fx[i] = fy[i] = fz[i] = 0;
+    }
+}
+
+void ParticleStore::integrate(real duration)
+{
+    integrate(duration, 0, size());
+}
+
+void ParticleStore::integrate_batch(real duration, unsigned begin, unsigned end)
+{
+    if (duration == 0.0)
+        return;
+
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    const realv dt = realv::broadcast(duration);
+    const realv zero = realv::broadcast(0);
+
+    // most scenes use one damping value for everything so the pow carries over between batches too
+    real last_damping = 0;
+    realv last_drag = realv::broadcast(1);
+
+    unsigned i = begin;
+    for (; i + width <= end; i += width)
+    {
+        realv vx = realv::load(&velocity_x[i]);
+        realv vy = realv::load(&velocity_y[i]);
+        realv vz = realv::load(&velocity_z[i]);
+
+        (realv::load(&position_x[i]) + vx * dt).store(&position_x[i]);
+        (realv::load(&position_y[i]) + vy * dt).store(&position_y[i]);
+        (realv::load(&position_z[i]) + vz * dt).store(&position_z[i]);
+
+        realv drag;
+        real first_damping = damping[i];
+        if (realv::load(&damping[i]).equals(first_damping))
+        {
+            if (i == begin || first_damping != last_damping)
+            {
+                last_damping = first_damping;
+                last_drag = realv::broadcast(real_pow(first_damping, duration));
+            }
+            drag = last_drag;
+        }
+        else
+        {
+            real lanes[GABBYPHYSICS_SIMD_WIDTH];
+            for (unsigned lane = 0; lane < width; lane++)
+                lanes[lane] = real_pow(damping[i + lane], duration);
+            drag = realv::load(lanes);
+        }
+
+        realv w = realv::load(&inverse_mass[i]);
+        ((vx + (realv::load(&acceleration_x[i]) + realv::load(&force_x[i]) * w) * dt) * drag).store(&velocity_x[i]);
+        ((vy + (realv::load(&acceleration_y[i]) + realv::load(&force_y[i]) * w) * dt) * drag).store(&velocity_y[i]);
+        ((vz + (realv::load(&acceleration_z[i]) + realv::load(&force_z[i]) * w) * dt) * drag).store(&velocity_z[i]);
+
+        zero.store(&force_x[i]);
+        zero.store(&force_y[i]);
+        zero.store(&force_z[i]);
+    }
+
+    // leftover slots that dont fill a batch
+    integrate(duration, i, end);
+}
+
+void ParticleStore::integrate_batch(real duration)
+{
+    integrate_batch(duration, 0, size());
+}
+
+void ParticleStore::clear_accumulators()
+{
+    force_x.assign(size(), 0);
+    force_y.assign(size(), 0);
+    force_z.assign(size(), 0);
+}
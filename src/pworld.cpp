@@ -1,48 +1,401 @@
 #include "gabbyphysics/pworld.h"
 #include "gabbyphysics/helper.h"
+#include "gabbyphysics/simd.h"
+
+#include "algorithm"
 
 using namespace gabbyphysics;
 
-ParticleWorld::ParticleWorld(unsigned max_contacts, unsigned iterations)
-    : resolver(iterations), max_contacts(max_contacts)
+ParticleWorld::ParticleWorld(unsigned contacts, unsigned iterations)
+    : reorder_interval(0), reorder_cell_size(1), frames_since_reorder(0),
+      resolver(iterations), solver_type(RESOLVER), contacts(contacts > 0 ? contacts : 1),
+      generator_contact_limit(UNLIMITED), used_contacts(0), random_seed(0)
 {
-    contacts = new ParticleContact[max_contacts];
     calculate_iterations = (iterations == 0);
-}
-
-ParticleWorld::~ParticleWorld()
-{
-    delete[] contacts;
+    reset_contact_stats();
+    seed_randoms();
 }
 
 void ParticleWorld::start_frame()
 {
+    if (reorder_interval > 0 && ++frames_since_reorder >= reorder_interval)
+    {
+        store.sort_spatially(reorder_cell_size);
+        frames_since_reorder = 0;
+    }
+
     for (Particles::iterator p = particles.begin();
          p != particles.end();
          p++)
     {
-        (*p)->clear_accumulator();
+        if ((*p)->get_store() != &store)
+            (*p)->clear_accumulator();
+    }
+    store.clear_accumulators();
+}
+
+void ParticleWorld::set_thread_count(unsigned threads)
+{
+    if (threads == 1)
+        jobs.reset();
+    else
+        jobs.reset(new JobPool(threads));
+
+    thread_contacts.clear();
+    thread_contact_counts.clear();
+    thread_contact_stats.clear();
+    thread_compact_contacts.clear();
+    seed_randoms();
+}
+
+unsigned ParticleWorld::get_thread_count() const
+{
+    return jobs ? jobs->get_thread_count() : 1;
+}
+
+JobPool *ParticleWorld::get_job_pool()
+{
+    return jobs.get();
+}
+
+void ParticleWorld::seed_randoms()
+{
+    randoms.assign(get_thread_count(), Random(random_seed));
+    for (unsigned t = 1; t < randoms.size(); t++)
+    {
+        randoms[t] = randoms[t - 1];
+        randoms[t].jump();
+    }
+}
+
+void ParticleWorld::set_random_seed(unsigned long long seed)
+{
+    random_seed = seed;
+    seed_randoms();
+}
+
+Random &ParticleWorld::get_random(unsigned thread)
+{
+    return randoms[thread];
+}
+
+void ParticleWorld::for_each_range(unsigned count, unsigned chunk_size, const JobPool::RangeJob &job)
+{
+    if (jobs)
+        jobs->parallel_for(count, chunk_size, job);
+    else if (count > 0)
+        job(0, count, 0);
+}
+
+// grows to at least needed, doubling so a scene that keeps growing only reallocates log n times
+static bool grow_contacts(std::vector<ParticleContact> &buffer, unsigned needed)
+{
+    if (needed <= buffer.size())
+        return false;
+
+    unsigned capacity = buffer.size() * 2;
+    if (capacity < needed)
+        capacity = needed;
+    buffer.resize(capacity);
+    return true;
+}
+
+unsigned ParticleWorld::generate_into(std::vector<ParticleContact> &buffer, unsigned used, const ParticleContactGenerator *generator,
+                                      ContactStats &stats) const
+{
+    for (;;)
+    {
+        // every generator gets at least one slot, some write their first contact without checking limit
+        if (grow_contacts(buffer, used + 1))
+            stats.grows++;
+
+        unsigned room = buffer.size() - used;
+        unsigned slice = room < generator_contact_limit ? room : generator_contact_limit;
+        unsigned added = generator->add_contact(buffer.data() + used, slice);
+
+        if (added < slice)
+            return used + added;
+        if (slice == generator_contact_limit)
+        {
+            // a generator with exactly limit contacts counts too, it cant tell us it had no more
+            stats.clipped++;
+            return used + added;
+        }
+
+        // filled the room it was given and may have more, run it again with more room
+        // relies on add_contact writing the same contacts when called twice, see ParticleContactGenerator
+        stats.regenerated++;
+        if (grow_contacts(buffer, buffer.size() * 2))
+            stats.grows++;
+    }
+}
+
+unsigned ParticleWorld::generate_contacts_parallel()
+{
+    const unsigned threads = jobs->get_thread_count();
+    const unsigned count = contact_generators.size();
+
+    unsigned chunk_size = count / (threads * 4);
+    if (chunk_size < 16)
+        chunk_size = 16;
+
+    if (thread_contacts.size() != threads)
+    {
+        // split the arena between threads to start with, each grows on its own after that
+        thread_contacts.assign(threads, std::vector<ParticleContact>(contacts.size() / threads + 1));
+        thread_contact_counts.resize(threads);
+    }
+    thread_contact_counts.assign(threads, 0);
+    thread_contact_stats.assign(threads, ContactStats());
+    contact_segments.resize((count + chunk_size - 1) / chunk_size);
+
+    jobs->parallel_for(count, chunk_size, [this, chunk_size](unsigned begin, unsigned end, unsigned thread)
+                       {
+        std::vector<ParticleContact> &buffer = thread_contacts[thread];
+        unsigned &used = thread_contact_counts[thread];
+
+        ContactSegment &segment = contact_segments[begin / chunk_size];
+        segment.thread = thread;
+        segment.offset = used;
+
+        for (unsigned g = begin; g < end; g++)
+        {
+            used = generate_into(buffer, used, contact_generators[g], thread_contact_stats[thread]);
+        }
+        segment.count = used - segment.offset; });
+
+    unsigned total = 0;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        total += thread_contact_counts[t];
+        contact_stats.grows += thread_contact_stats[t].grows;
+        contact_stats.regenerated += thread_contact_stats[t].regenerated;
+        contact_stats.clipped += thread_contact_stats[t].clipped;
     }
+    if (grow_contacts(contacts, total))
+        contact_stats.grows++;
+
+    // segments are in generator order so the merged contacts match the serial path
+    total = 0;
+    for (std::vector<ContactSegment>::iterator s = contact_segments.begin();
+         s != contact_segments.end();
+         s++)
+    {
+        const ParticleContact *source = thread_contacts[s->thread].data() + s->offset;
+        std::copy(source, source + s->count, contacts.begin() + total);
+        total += s->count;
+    }
+
+    return total;
 }
 
 unsigned ParticleWorld::generate_contacts()
 {
-    unsigned limit = max_contacts;
-    ParticleContact *next_contact = contacts;
+    contact_stats.clipped = 0;
+
+    unsigned used = 0;
+    if (jobs && jobs->get_thread_count() > 1)
+    {
+        used = generate_contacts_parallel();
+    }
+    else
+    {
+        for (ContactGenerators::iterator g = contact_generators.begin();
+             g != contact_generators.end();
+             g++)
+        {
+            used = generate_into(contacts, used, *g, contact_stats);
+        }
+    }
+
+    contact_stats.capacity = contacts.size();
+    if (used > contact_stats.high_water)
+        contact_stats.high_water = used;
+    return used;
+}
+
+void ParticleWorld::generate_compact_into(ParticleCompactContacts &table, const ParticleContactGenerator *generator,
+                                          ContactStats &stats) const
+{
+    unsigned capacity = table.capacity();
+    unsigned added = generator->add_contacts(table, generator_contact_limit);
+    if (added == generator_contact_limit)
+        stats.clipped++;
+    if (table.capacity() != capacity)
+        stats.grows++;
+}
+
+void ParticleWorld::generate_compact_contacts_parallel()
+{
+    const unsigned threads = jobs->get_thread_count();
+    const unsigned count = contact_generators.size();
+
+    unsigned chunk_size = count / (threads * 4);
+    if (chunk_size < 16)
+        chunk_size = 16;
+
+    thread_compact_contacts.resize(threads);
+    for (unsigned t = 0; t < threads; t++)
+        thread_compact_contacts[t].clear();
+    thread_contact_stats.assign(threads, ContactStats());
+    compact_segments.resize((count + chunk_size - 1) / chunk_size);
+
+    jobs->parallel_for(count, chunk_size, [this, chunk_size](unsigned begin, unsigned end, unsigned thread)
+                       {
+        ParticleCompactContacts &table = thread_compact_contacts[thread];
+
+        CompactSegment &segment = compact_segments[begin / chunk_size];
+        segment.thread = thread;
+        segment.begin = table.mark();
+
+        for (unsigned g = begin; g < end; g++)
+        {
+            generate_compact_into(table, contact_generators[g], thread_contact_stats[thread]);
+        }
+        segment.end = table.mark(); });
+
+    for (unsigned t = 0; t < threads; t++)
+    {
+        contact_stats.grows += thread_contact_stats[t].grows;
+        contact_stats.clipped += thread_contact_stats[t].clipped;
+    }
+
+    // segments are in generator order so the merged contacts match the serial path
+    unsigned capacity = compact_contacts.capacity();
+    for (std::vector<CompactSegment>::iterator s = compact_segments.begin();
+         s != compact_segments.end();
+         s++)
+    {
+        compact_contacts.append(thread_compact_contacts[s->thread], s->begin, s->end);
+    }
+    if (compact_contacts.capacity() != capacity)
+        contact_stats.grows++;
+}
+
+unsigned ParticleWorld::generate_compact_contacts()
+{
+    contact_stats.clipped = 0;
+    compact_contacts.clear();
+
+    if (jobs && jobs->get_thread_count() > 1)
+    {
+        generate_compact_contacts_parallel();
+    }
+    else
+    {
+        for (ContactGenerators::iterator g = contact_generators.begin();
+             g != contact_generators.end();
+             g++)
+        {
+            generate_compact_into(compact_contacts, *g, contact_stats);
+        }
+    }
+
+    unsigned used = compact_contacts.size();
+    contact_stats.capacity = compact_contacts.capacity();
+    if (used > contact_stats.high_water)
+        contact_stats.high_water = used;
+    return used;
+}
+
+// zero fills the lanes past count so fields can run whole simd batches, returns the total force of each lane
+static void sweep_force_fields(const ParticleWorld::ForceFields &fields, ParticleFieldBlock &block, const unsigned *layers,
+                               unsigned count, real duration, real *total_x, real *total_y, real *total_z)
+{
+    const unsigned width = GABBYPHYSICS_SIMD_WIDTH;
+    block.lanes = (count + width - 1) / width * width;
+    real *inputs[7] = {block.position_x, block.position_y, block.position_z,
+                       block.velocity_x, block.velocity_y, block.velocity_z, block.inverse_mass};
+    for (unsigned n = 0; n < 7; n++)
+        std::fill(inputs[n] + count, inputs[n] + block.lanes, 0);
 
-    for (ContactGenerators::iterator g = contact_generators.begin();
-         g != contact_generators.end();
-         g++)
+    std::fill(total_x, total_x + count, 0);
+    std::fill(total_y, total_y + count, 0);
+    std::fill(total_z, total_z + count, 0);
+
+    for (ParticleWorld::ForceFields::const_iterator f = fields.begin(); f != fields.end(); f++)
     {
-        unsigned used = (*g)->add_contact(next_contact, limit);
-        limit -= used;
-        next_contact += used;
+        (*f)->compute(block, duration);
 
-        if (limit <= 0)
-            break;
+        const unsigned mask = (*f)->mask;
+        for (unsigned i = 0; i < count; i++)
+        {
+            real active = (layers[i] & mask) ? 1 : 0;
+            total_x[i] += block.force_x[i] * active;
+            total_y[i] += block.force_y[i] * active;
+            total_z[i] += block.force_z[i] * active;
+        }
     }
+}
+
+void ParticleWorld::apply_force_fields(real duration)
+{
+    if (force_fields.empty())
+        return;
+
+    const unsigned size = ParticleFieldBlock::SIZE;
+
+    // particles outside the store, gathered one at a time
+    for_each_range(particles.size(), size * 4, [this, duration, size](unsigned begin, unsigned end, unsigned thread)
+                   {
+        ParticleFieldBlock block;
+        Particle *members[ParticleFieldBlock::SIZE];
+        unsigned layers[ParticleFieldBlock::SIZE];
+        real total_x[ParticleFieldBlock::SIZE], total_y[ParticleFieldBlock::SIZE], total_z[ParticleFieldBlock::SIZE];
+
+        unsigned i = begin;
+        while (i < end)
+        {
+            unsigned count = 0;
+            for (; i < end && count < size; i++)
+            {
+                Particle *particle = particles[i];
+                if (particle->get_store() == &store)
+                    continue;
+
+                Vector3 position = particle->get_position();
+                Vector3 velocity = particle->get_velocity();
+                block.position_x[count] = position.x;
+                block.position_y[count] = position.y;
+                block.position_z[count] = position.z;
+                block.velocity_x[count] = velocity.x;
+                block.velocity_y[count] = velocity.y;
+                block.velocity_z[count] = velocity.z;
+                block.inverse_mass[count] = particle->get_inverse_mass();
+                layers[count] = particle->get_layers();
+                members[count++] = particle;
+            }
 
-    return max_contacts - limit;
+            sweep_force_fields(force_fields, block, layers, count, duration, total_x, total_y, total_z);
+            for (unsigned n = 0; n < count; n++)
+                members[n]->add_force(Vector3(total_x[n], total_y[n], total_z[n]));
+        } });
+
+    // store particles, copied in and added back slot by slot
+    for_each_range(store.size(), size * 4, [this, duration, size](unsigned begin, unsigned end, unsigned thread)
+                   {
+        ParticleFieldBlock block;
+        real total_x[ParticleFieldBlock::SIZE], total_y[ParticleFieldBlock::SIZE], total_z[ParticleFieldBlock::SIZE];
+
+        for (; begin < end; begin += size)
+        {
+            unsigned count = end - begin < size ? end - begin : size;
+            std::copy(&store.position_x[begin], &store.position_x[begin] + count, block.position_x);
+            std::copy(&store.position_y[begin], &store.position_y[begin] + count, block.position_y);
+            std::copy(&store.position_z[begin], &store.position_z[begin] + count, block.position_z);
+            std::copy(&store.velocity_x[begin], &store.velocity_x[begin] + count, block.velocity_x);
+            std::copy(&store.velocity_y[begin], &store.velocity_y[begin] + count, block.velocity_y);
+            std::copy(&store.velocity_z[begin], &store.velocity_z[begin] + count, block.velocity_z);
+            std::copy(&store.inverse_mass[begin], &store.inverse_mass[begin] + count, block.inverse_mass);
+
+            sweep_force_fields(force_fields, block, &store.layers[begin], count, duration, total_x, total_y, total_z);
+            for (unsigned n = 0; n < count; n++)
+            {
+                store.force_x[begin + n] += total_x[n];
+                store.force_y[begin + n] += total_y[n];
+                store.force_z[begin + n] += total_z[n];
+            }
+        } });
 }
 
 void ParticleWorld::integrate(real duration)
@@ -51,23 +404,62 @@ void ParticleWorld::integrate(real duration)
          p != particles.end();
          p++)
     {
-        (*p)->integrate(duration);
+        if ((*p)->get_store() != &store)
+            (*p)->integrate(duration);
     }
+    store.integrate(duration);
+}
+
+void ParticleWorld::integrate_batch(real duration)
+{
+    for_each_range(particles.size(), 1024, [this, duration](unsigned begin, unsigned end, unsigned thread)
+                   {
+        for (unsigned i = begin; i < end; i++)
+        {
+            if (particles[i]->get_store() != &store)
+                particles[i]->integrate(duration);
+        } });
+
+    // chunks are a multiple of every simd width so only the last one has a scalar tail
+    for_each_range(store.size(), 4096, [this, duration](unsigned begin, unsigned end, unsigned thread)
+                   { store.integrate_batch(duration, begin, end); });
 }
 
 void ParticleWorld::run_physics(real duration)
 {
-    registry.update_forces(duration);
+    registry.update_forces(duration, jobs.get());
+    apply_force_fields(duration);
 
-    integrate(duration);
+    integrate_batch(duration);
 
-    unsigned used_contacts = generate_contacts();
+    if (solver_type == RESOLVER && resolver.get_mode() == ParticleContactResolver::ITERATIVE)
+    {
+        used_contacts = generate_compact_contacts();
+        // particles in more than one store cant all be referred to by slot, so those frames use ParticleContacts
+        if (!compact_contacts.is_mixed())
+        {
+            if (calculate_iterations)
+            {
+                resolver.set_iterations(used_contacts * 2);
+            }
+            resolver.resolve_contacts(compact_contacts, duration);
+            return;
+        }
+    }
+
+    used_contacts = generate_contacts();
+
+    if (solver_type == SEQUENTIAL_IMPULSE)
+    {
+        solver.solve_contacts(contacts.data(), used_contacts, duration, jobs.get());
+        return;
+    }
 
     if (calculate_iterations)
     {
         resolver.set_iterations(used_contacts * 2);
     }
-    resolver.resolve_contacts(contacts, used_contacts, duration);
+    resolver.resolve_contacts(contacts.data(), used_contacts, duration);
 }
 
 ParticleWorld::Particles &ParticleWorld::get_particles()
@@ -75,6 +467,23 @@ ParticleWorld::Particles &ParticleWorld::get_particles()
     return particles;
 }
 
+ParticleStore &ParticleWorld::get_particle_store()
+{
+    return store;
+}
+
+void ParticleWorld::set_reorder_interval(unsigned frames, real cell_size)
+{
+    reorder_interval = frames;
+    reorder_cell_size = cell_size;
+    frames_since_reorder = 0;
+}
+
+unsigned ParticleWorld::get_reorder_interval() const
+{
+    return reorder_interval;
+}
+
 ParticleWorld::ContactGenerators &ParticleWorld::get_contact_generators()
 {
     return contact_generators;
@@ -85,6 +494,65 @@ ParticleForceRegistry &ParticleWorld::get_force_registry()
     return registry;
 }
 
+ParticleWorld::ForceFields &ParticleWorld::get_force_fields()
+{
+    return force_fields;
+}
+
+ParticleContactResolver &ParticleWorld::get_contact_resolver()
+{
+    return resolver;
+}
+
+ParticleContactSolver &ParticleWorld::get_contact_solver()
+{
+    return solver;
+}
+
+void ParticleWorld::set_contact_solver_type(ContactSolverType type)
+{
+    solver_type = type;
+}
+
+ParticleWorld::ContactSolverType ParticleWorld::get_contact_solver_type() const
+{
+    return solver_type;
+}
+
+unsigned ParticleWorld::get_contact_count() const
+{
+    return used_contacts;
+}
+
+void ParticleWorld::set_generator_contact_limit(unsigned limit)
+{
+    generator_contact_limit = limit > 0 ? limit : 1;
+}
+
+unsigned ParticleWorld::get_generator_contact_limit() const
+{
+    return generator_contact_limit;
+}
+
+void ParticleWorld::reserve_contacts(unsigned capacity)
+{
+    if (capacity > contacts.size())
+        contacts.resize(capacity);
+    compact_contacts.reserve(capacity);
+    contact_stats.capacity = contacts.size();
+}
+
+const ParticleWorld::ContactStats &ParticleWorld::get_contact_stats() const
+{
+    return contact_stats;
+}
+
+void ParticleWorld::reset_contact_stats()
+{
+    contact_stats = ContactStats();
+    contact_stats.capacity = contacts.size();
+}
+
 void GroundContacts::init(gabbyphysics::ParticleWorld::Particles *particles, gabbyphysics::real world_x, gabbyphysics::real world_y)
 {
     GroundContacts::particles = particles;
@@ -102,6 +570,8 @@ unsigned GroundContacts::add_contact(gabbyphysics::ParticleContact *contact, uns
         auto pp = (*p)->get_position();
         if (pp.y < 0.0f || pp.y > world_y)
         {
+            if (count >= limit)
+                return count;
             contact->contact_normal = gabbyphysics::Vector3::UP;
             contact->particle[0] = *p;
             contact->particle[1] = NULL;
@@ -113,6 +583,9 @@ unsigned GroundContacts::add_contact(gabbyphysics::ParticleContact *contact, uns
 
         if (pp.x < 0.0f || pp.x > world_x)
         {
+            // a particle can be outside on both axes, so check again before the second contact
+            if (count >= limit)
+                return count;
             contact->contact_normal = gabbyphysics::Vector3::RIGHT;
             contact->particle[0] = *p;
             contact->particle[1] = NULL;
@@ -121,9 +594,6 @@ unsigned GroundContacts::add_contact(gabbyphysics::ParticleContact *contact, uns
             contact++;
             count++;
         }
-
-        if (count >= limit)
-            return count;
     }
     return count;
 }